@@ -0,0 +1,294 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// streaming reducers used as RowVisitor, aggregate a dict while parsing it
+// every reducer has a merge function to combine the results of worker threads
+
+#ifndef GOODCODER_AGGREGATOR_H
+#define GOODCODER_AGGREGATOR_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "parser.h"
+
+namespace baidu {
+
+/**
+ * ColumnType is the value type held by a column parser P
+ * P may be Parser<T, pars> or any class with a data() member, such as DictStringParser
+ */
+template <typename P>
+struct ColumnType {
+    typedef typename std::decay<decltype(std::declval<P&>().data())>::type type;
+};
+
+/**
+ * VisitorGroup forwards every row to several visitors
+ * use it to run several reducers in one pass
+ */
+class VisitorGroup : public RowVisitor {
+public:
+    VisitorGroup() {};
+
+    void add_visitor(RowVisitor* v) {
+        _v.push_back(v);
+    }
+
+    virtual void visit() override {
+        for (size_t i = 0; i < _v.size(); i++) {
+            _v[i]->visit();
+        }
+    }
+private:
+    std::vector<RowVisitor*> _v;
+    DISALLOW_COPY_AND_ASSIGN(VisitorGroup);
+};
+
+/**
+ * ColumnCollector appends a column of every row to a vector
+ * merge() appends the rows of another worker, in worker order
+ * Alloc allocates the vector, e.g. HugePageAllocator for big columns
+ */
+template <typename P, typename Alloc = std::allocator<typename ColumnType<P>::type> >
+class ColumnCollector : public RowVisitor {
+public:
+    typedef typename ColumnType<P>::type value_type;
+
+    explicit ColumnCollector(P* column, const Alloc& alloc = Alloc()) :
+            _column(column), _result(alloc) {};
+
+    virtual void visit() override {
+        _result.push_back(_column->data());
+    }
+
+    void merge(const ColumnCollector& other) {
+        _result.insert(_result.end(), other._result.begin(), other._result.end());
+    }
+
+    std::vector<value_type, Alloc>& result() {
+        return _result;
+    }
+private:
+    P* _column;
+    std::vector<value_type, Alloc> _result;
+    DISALLOW_COPY_AND_ASSIGN(ColumnCollector);
+};
+
+/**
+ * CountReducer counts the valid rows
+ */
+class CountReducer : public RowVisitor {
+public:
+    CountReducer() : _count(0) {};
+
+    virtual void visit() override {
+        _count++;
+    }
+
+    void merge(const CountReducer& other) {
+        _count += other._count;
+    }
+
+    size_t count() const {
+        return _count;
+    }
+private:
+    size_t _count;
+    DISALLOW_COPY_AND_ASSIGN(CountReducer);
+};
+
+/**
+ * SumReducer sums a column
+ * the second template parameter is the type of the sum, use a wider type to avoid overflow
+ */
+template <typename P, typename A = typename ColumnType<P>::type>
+class SumReducer : public RowVisitor {
+public:
+    explicit SumReducer(P* column) : _column(column), _sum() {};
+
+    virtual void visit() override {
+        _sum += _column->data();
+    }
+
+    void merge(const SumReducer& other) {
+        _sum += other._sum;
+    }
+
+    const A& sum() const {
+        return _sum;
+    }
+private:
+    P* _column;
+    A _sum;
+    DISALLOW_COPY_AND_ASSIGN(SumReducer);
+};
+
+/**
+ * MinMaxReducer keeps the min and the max value of a column
+ * min() and max() are meaningless when empty() is true
+ */
+template <typename P>
+class MinMaxReducer : public RowVisitor {
+public:
+    typedef typename ColumnType<P>::type value_type;
+
+    explicit MinMaxReducer(P* column) : _column(column), _count(0), _min(), _max() {};
+
+    virtual void visit() override {
+        update(_column->data());
+    }
+
+    void merge(const MinMaxReducer& other) {
+        if (!other.empty()) {
+            update(other._min);
+            update(other._max);
+        }
+    }
+
+    bool empty() const {
+        return _count == 0;
+    }
+
+    const value_type& min() const {
+        return _min;
+    }
+
+    const value_type& max() const {
+        return _max;
+    }
+private:
+    void update(const value_type& v) {
+        if (_count == 0 || v < _min) {
+            _min = v;
+        }
+        if (_count == 0 || _max < v) {
+            _max = v;
+        }
+        _count++;
+    }
+
+    P* _column;
+    size_t _count;
+    value_type _min;
+    value_type _max;
+    DISALLOW_COPY_AND_ASSIGN(MinMaxReducer);
+};
+
+/**
+ * TopKReducer keeps the k rows with the largest score column
+ * for every kept row it holds the score and the key column, memory is O(k)
+ */
+template <typename S, typename K>
+class TopKReducer : public RowVisitor {
+public:
+    typedef std::pair<typename ColumnType<S>::type, typename ColumnType<K>::type> value_type;
+
+    TopKReducer(S* score, K* key, size_t k) : _score(score), _key(key), _k(k) {
+        _heap.reserve(k);
+    };
+
+    virtual void visit() override {
+        //k is 0, the heap stays empty and has no front()
+        if (_k == 0) {
+            return;
+        }
+        if (_heap.size() < _k || _heap.front().first < _score->data()) {
+            push(value_type(_score->data(), _key->data()));
+        }
+    }
+
+    void merge(const TopKReducer& other) {
+        for (size_t i = 0; i < other._heap.size(); i++) {
+            push(other._heap[i]);
+        }
+    }
+
+    /**
+     * @brief get the kept rows
+     * @return std::vector<value_type>
+     * @retval (score, key) pairs, sorted by score in descending order
+    **/
+    std::vector<value_type> result() const {
+        std::vector<value_type> v(_heap);
+        std::sort(v.begin(), v.end(), greater);
+        return v;
+    }
+private:
+    static bool greater(const value_type& a, const value_type& b) {
+        return b.first < a.first;
+    }
+
+    //_heap is a min-heap on score, front() is the smallest kept score
+    void push(const value_type& v) {
+        if (_k == 0) {
+            return;
+        }
+        if (_heap.size() == _k) {
+            if (!(_heap.front().first < v.first)) {
+                return;
+            }
+            std::pop_heap(_heap.begin(), _heap.end(), greater);
+            _heap.back() = v;
+        } else {
+            _heap.push_back(v);
+        }
+        std::push_heap(_heap.begin(), _heap.end(), greater);
+    }
+
+    S* _score;
+    K* _key;
+    size_t _k;
+    std::vector<value_type> _heap;
+    DISALLOW_COPY_AND_ASSIGN(TopKReducer);
+};
+
+/**
+ * KeyedSumReducer sums and counts the value column for every distinct key
+ * memory is bounded by the number of distinct keys, not by the file size
+ * in a single thread, use DictStringParser for string keys to keep one copy of each key;
+ * workers of ParallelDictParser should use their own Parser<std::string> instead
+ */
+template <typename K, typename V, typename A = typename ColumnType<V>::type>
+class KeyedSumReducer : public RowVisitor {
+public:
+    typedef typename ColumnType<K>::type key_type;
+    //sum and count of one key
+    typedef std::pair<A, size_t> value_type;
+    typedef std::unordered_map<key_type, value_type> map_type;
+
+    KeyedSumReducer(K* key, V* value) : _key(key), _value(value) {};
+
+    virtual void visit() override {
+        value_type& v = _result[_key->data()];
+        v.first += _value->data();
+        v.second++;
+    }
+
+    void merge(const KeyedSumReducer& other) {
+        for (typename map_type::const_iterator it = other._result.begin();
+                it != other._result.end(); ++it) {
+            value_type& v = _result[it->first];
+            v.first += it->second.first;
+            v.second += it->second.second;
+        }
+    }
+
+    const map_type& result() const {
+        return _result;
+    }
+private:
+    K* _key;
+    V* _value;
+    map_type _result;
+    DISALLOW_COPY_AND_ASSIGN(KeyedSumReducer);
+};
+
+}
+#endif // GOODCODER_AGGREGATOR_H
@@ -0,0 +1,185 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test reducers and ParallelDictParser
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "aggregator.h"
+#include "parallel_parser.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::DictParser;
+using baidu::ParallelDictParser;
+using baidu::VisitorGroup;
+using baidu::CountReducer;
+using baidu::SumReducer;
+using baidu::MinMaxReducer;
+using baidu::TopKReducer;
+using baidu::KeyedSumReducer;
+
+//test reducers with DictParser::parse_all
+TEST(Reducer, parse_all) {
+    Parser<int> p0;
+    Parser<float> p1;
+    Parser<double> p2;
+    Parser<std::string> p3;
+    Parser<std::vector<float>> p4;
+    Parser<std::vector<int>> p5;
+    Parser<std::string> p6;
+    DictParser dp("demo.txt");
+    dp.add_column(&p0);
+    dp.add_column(&p1);
+    dp.add_column(&p2);
+    dp.add_column(&p3);
+    dp.add_column(&p4);
+    dp.add_column(&p5);
+    dp.add_column(&p6);
+
+    CountReducer count;
+    SumReducer<Parser<int>, int64_t> sum(&p0);
+    MinMaxReducer<Parser<double>> min_max(&p2);
+    TopKReducer<Parser<int>, Parser<std::string>> top(&p0, &p3, 2);
+    TopKReducer<Parser<int>, Parser<std::string>> top_none(&p0, &p3, 0);
+    KeyedSumReducer<Parser<std::string>, Parser<int>> keyed(&p3, &p0);
+    VisitorGroup group;
+    group.add_visitor(&count);
+    group.add_visitor(&sum);
+    group.add_visitor(&min_max);
+    group.add_visitor(&top);
+    group.add_visitor(&top_none);
+    group.add_visitor(&keyed);
+
+    //the second line of demo.txt is invalid
+    EXPECT_EQ(dp.parse_all(&group), 3);
+    EXPECT_EQ(count.count(), 3);
+    EXPECT_EQ(sum.sum(), 6);
+    ASSERT_FALSE(min_max.empty());
+    EXPECT_DOUBLE_EQ(min_max.min(), 12);
+    EXPECT_DOUBLE_EQ(min_max.max(), 23.6666);
+
+    std::vector<std::pair<int, std::string> > r = top.result();
+    ASSERT_EQ(r.size(), 2);
+    EXPECT_EQ(r[0].first, 3);
+    EXPECT_EQ(r[1].first, 2);
+    top_none.merge(top);
+    EXPECT_TRUE(top_none.result().empty());
+
+    ASSERT_EQ(keyed.result().size(), 2);
+    EXPECT_EQ(keyed.result().at("fucheng").first, 4);
+    EXPECT_EQ(keyed.result().at("fucheng").second, 2);
+
+    //nothing left
+    EXPECT_EQ(dp.parse_all(&group), 0);
+}
+
+//a worker of ParallelDictParser, owns its columns and reducers
+struct Worker {
+    Parser<int> key;
+    Parser<int> value;
+    LineParser lp;
+    CountReducer count;
+    SumReducer<Parser<int>, int64_t> sum;
+    MinMaxReducer<Parser<int>> min_max;
+    TopKReducer<Parser<int>, Parser<int>> top;
+    KeyedSumReducer<Parser<int>, Parser<int>, int64_t> keyed;
+    VisitorGroup group;
+
+    Worker() : sum(&value), min_max(&value), top(&value, &key, 3), keyed(&key, &value) {
+        lp.add_parser(&key);
+        lp.add_parser(&value);
+        group.add_visitor(&count);
+        group.add_visitor(&sum);
+        group.add_visitor(&min_max);
+        group.add_visitor(&top);
+        group.add_visitor(&keyed);
+    }
+};
+
+//test merging reducers of several worker threads
+TEST(Reducer, parallel) {
+    const char* path = "parallel_agg.txt";
+    const int lines = 10007;
+    std::ofstream out(path);
+    for (int i = 0; i < lines; i++) {
+        if (i % 100 == 7) {
+            out << "bad line\n";
+        } else {
+            out << i % 10 << "\t" << i << "\n";
+        }
+    }
+    out.close();
+
+    for (int n = 1; n <= 8; n *= 2) {
+        std::vector<Worker*> workers;
+        ParallelDictParser pdp(path);
+        for (int i = 0; i < n; i++) {
+            workers.push_back(new Worker());
+            pdp.add_worker(&workers[i]->lp, &workers[i]->group);
+        }
+        ASSERT_EQ(pdp.parse(), 0);
+        for (int i = 1; i < n; i++) {
+            workers[0]->count.merge(workers[i]->count);
+            workers[0]->sum.merge(workers[i]->sum);
+            workers[0]->min_max.merge(workers[i]->min_max);
+            workers[0]->top.merge(workers[i]->top);
+            workers[0]->keyed.merge(workers[i]->keyed);
+        }
+
+        int64_t expect_sum = 0;
+        int64_t expect_key3 = 0;
+        size_t expect_count = 0;
+        for (int i = 0; i < lines; i++) {
+            if (i % 100 != 7) {
+                expect_sum += i;
+                expect_count++;
+                expect_key3 += (i % 10 == 3) ? i : 0;
+            }
+        }
+        Worker* w = workers[0];
+        EXPECT_EQ(pdp.good_lines(), expect_count);
+        EXPECT_EQ(pdp.bad_lines(), lines - expect_count);
+        EXPECT_EQ(w->count.count(), expect_count);
+        EXPECT_EQ(w->sum.sum(), expect_sum);
+        EXPECT_EQ(w->min_max.min(), 0);
+        EXPECT_EQ(w->min_max.max(), lines - 1);
+        std::vector<std::pair<int, int> > r = w->top.result();
+        ASSERT_EQ(r.size(), 3);
+        EXPECT_EQ(r[0].first, lines - 1);
+        EXPECT_EQ(r[0].second, (lines - 1) % 10);
+        EXPECT_EQ(r[2].first, lines - 3);
+        EXPECT_EQ(w->keyed.result().size(), 10);
+        EXPECT_EQ(w->keyed.result().at(3).first, expect_key3);
+        for (int i = 0; i < n; i++) {
+            delete workers[i];
+        }
+    }
+    remove(path);
+}
+
+//test ParallelDictParser for file not exist
+TEST(ParallelDictParser, no_file) {
+    Worker w;
+    ParallelDictParser pdp("no.txt");
+    EXPECT_EQ(pdp.parse(), -1);
+    pdp.add_worker(&w.lp, &w.group);
+    EXPECT_EQ(pdp.parse(), -1);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
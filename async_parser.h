@@ -0,0 +1,108 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// AsyncParseTask parse a dict slice by slice on a caller-supplied executor,
+// so loading a dict never blocks an event loop for long
+
+#ifndef GOODCODER_ASYNC_PARSER_H
+#define GOODCODER_ASYNC_PARSER_H
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "parser.h"
+
+namespace baidu {
+
+/**
+ * Executor is implemented by the caller, for example by an event loop
+ * post() should run the task later on the caller's thread and return at once
+ */
+class Executor {
+public:
+    virtual void post(const std::function<void()>& task) = 0;
+    virtual ~Executor() {};
+};
+
+/**
+ * AsyncParseTask is a resumable parse of a DictParser
+ * every step parses at most max_lines lines or runs at most max_us microseconds,
+ * the next step resumes from the next line without re-scanning the file
+ * the task must outlive the done callback
+ */
+class AsyncParseTask {
+public:
+    typedef std::function<void(size_t)> DoneCallback;
+
+    /**
+     * @param [in] DictParser* dp, columns should be added before start
+     * @param [in] RowVisitor* visitor, called after every valid line
+     * @param [in] size_t max_lines, max lines of one step
+     * @param [in] int64_t max_us, max microseconds of one step
+    **/
+    AsyncParseTask(DictParser* dp, RowVisitor* visitor, size_t max_lines, int64_t max_us) :
+            _dp(dp), _visitor(visitor), _max_lines(max_lines), _max_us(max_us),
+            _executor(NULL), _good(0), _steps(0) {};
+
+    /**
+     * @brief parse one slice, used directly by callers without an executor
+     * @param
+     * @return bool
+     * @retval true:the whole file is parsed, false:call step again later
+    **/
+    bool step() {
+        if (_dp->is_file_end()) {
+            return true;
+        }
+        _good += _dp->parse_some(_visitor, _max_lines, _max_us);
+        _steps++;
+        return _dp->is_file_end();
+    }
+
+    /**
+     * @brief post the steps to executor one by one until the file ends
+     * @param [in] Executor* executor
+     * @param [in] DoneCallback done, called with the number of valid lines
+     * @return void
+    **/
+    void start(Executor* executor, const DoneCallback& done) {
+        _executor = executor;
+        _done = done;
+        _executor->post(std::bind(&AsyncParseTask::run, this));
+    }
+
+    //number of valid lines parsed so far
+    size_t good_lines() const {
+        return _good;
+    }
+
+    //number of steps run so far
+    size_t steps() const {
+        return _steps;
+    }
+
+private:
+    void run() {
+        if (step()) {
+            if (_done) {
+                _done(_good);
+            }
+            return;
+        }
+        _executor->post(std::bind(&AsyncParseTask::run, this));
+    }
+
+    DictParser* _dp;
+    RowVisitor* _visitor;
+    size_t _max_lines;
+    int64_t _max_us;
+    Executor* _executor;
+    DoneCallback _done;
+    size_t _good;
+    size_t _steps;
+    DISALLOW_COPY_AND_ASSIGN(AsyncParseTask);
+};
+
+}
+#endif // GOODCODER_ASYNC_PARSER_H
@@ -0,0 +1,149 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test AsyncParseTask and DictParser::parse_some
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "aggregator.h"
+#include "async_parser.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::DictParser;
+using baidu::CountReducer;
+using baidu::SumReducer;
+using baidu::VisitorGroup;
+using baidu::Executor;
+using baidu::AsyncParseTask;
+
+//an event loop with a task queue, run by the test thread
+class QueueExecutor : public Executor {
+public:
+    virtual void post(const std::function<void()>& task) override {
+        _tasks.push_back(task);
+    }
+
+    bool run_one() {
+        if (_tasks.empty()) {
+            return false;
+        }
+        std::function<void()> task = _tasks.front();
+        _tasks.pop_front();
+        task();
+        return true;
+    }
+private:
+    std::deque<std::function<void()> > _tasks;
+};
+
+//write a two column dict, every 10th line is invalid
+static void write_dict(const char* path, int lines) {
+    std::ofstream out(path);
+    for (int i = 0; i < lines; i++) {
+        if (i % 10 == 9) {
+            out << "bad\n";
+        } else {
+            out << i << "\t" << i * 0.5 << "\n";
+        }
+    }
+}
+
+//test parse_some resumes from the next line
+TEST(DictParser, parse_some) {
+    const char* path = "async_some.txt";
+    write_dict(path, 100);
+    Parser<int> p0;
+    Parser<float> p1;
+    DictParser dp(path);
+    dp.add_column(&p0);
+    dp.add_column(&p1);
+    CountReducer count;
+
+    EXPECT_EQ(dp.parse_some(&count, 20, 1000000), 18);
+    EXPECT_EQ(p0.data(), 18);
+    EXPECT_FALSE(dp.is_file_end());
+    //no time left, still read one line
+    EXPECT_EQ(dp.parse_some(&count, 20, 0), 1);
+    EXPECT_EQ(p0.data(), 20);
+    EXPECT_EQ(dp.parse_some(&count, 1000, 1000000), 71);
+    EXPECT_TRUE(dp.is_file_end());
+    EXPECT_EQ(count.count(), 90);
+    remove(path);
+}
+
+//test AsyncParseTask interleaves with other tasks of the executor
+TEST(AsyncParseTask, executor) {
+    const char* path = "async_task.txt";
+    write_dict(path, 1000);
+    Parser<int> p0;
+    Parser<float> p1;
+    DictParser dp(path);
+    dp.add_column(&p0);
+    dp.add_column(&p1);
+    CountReducer count;
+    SumReducer<Parser<int>, int64_t> sum(&p0);
+    VisitorGroup group;
+    group.add_visitor(&count);
+    group.add_visitor(&sum);
+
+    QueueExecutor executor;
+    AsyncParseTask task(&dp, &group, 64, 1000000);
+    size_t done_lines = 0;
+    bool done = false;
+    int requests = 0;
+    int requests_before_done = 0;
+    task.start(&executor, [&](size_t good) {
+        done = true;
+        done_lines = good;
+        requests_before_done = requests;
+    });
+
+    //a request arrives after every task, it is handled between the steps
+    for (int i = 0; i < 100 && !done; i++) {
+        executor.post([&requests]() { requests++; });
+        executor.run_one();
+        executor.run_one();
+    }
+    EXPECT_TRUE(done);
+    EXPECT_EQ(done_lines, 900);
+    EXPECT_EQ(count.count(), 900);
+    EXPECT_EQ(task.steps(), 16);
+    EXPECT_EQ(requests_before_done, 15);
+
+    int64_t expect_sum = 0;
+    for (int i = 0; i < 1000; i++) {
+        expect_sum += (i % 10 == 9) ? 0 : i;
+    }
+    EXPECT_EQ(sum.sum(), expect_sum);
+    remove(path);
+}
+
+//test AsyncParseTask::step without executor
+TEST(AsyncParseTask, step) {
+    Parser<int> p0;
+    DictParser dp("no.txt");
+    dp.add_column(&p0);
+    CountReducer count;
+    AsyncParseTask task(&dp, &count, 10, 1000);
+    EXPECT_TRUE(task.step());
+    EXPECT_EQ(task.steps(), 0);
+    EXPECT_EQ(task.good_lines(), 0);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,258 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// KeyedTable holds the rows of a dict by key, and reloads only the rows changed in a new version
+
+#ifndef GOODCODER_DELTA_RELOAD_H
+#define GOODCODER_DELTA_RELOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "parser.h"
+
+namespace baidu {
+
+/**
+ * @brief 64 bit hash of a raw line, MurmurHash64A, reads 8 bytes every step
+ * @param [in] const char* data
+ * @param [in] size_t len
+ * @param [in] uint64_t seed
+ * @return uint64_t
+**/
+inline uint64_t hash_bytes(const char* data, size_t len, uint64_t seed = 0) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m);
+    const char* end = data + len / 8 * 8;
+    for (const char* p = data; p != end; p += 8) {
+        uint64_t k = 0;
+        memcpy(&k, p, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, end, len & 7);
+    if ((len & 7) != 0) {
+        h ^= tail;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+/**
+ * RowFiller copies the columns parsed by a LineParser to a row of a KeyedTable
+ * the row keeps the memory of its last version, so assigning or swapping into it is cheap
+ */
+template <typename R>
+class RowFiller {
+public:
+    virtual void fill(R& row) = 0;
+    virtual ~RowFiller() {};
+};
+
+//what the last reload did
+struct ReloadStats {
+    size_t lines;
+    //lines equal to the loaded version, not parsed
+    size_t unchanged;
+    size_t changed;
+    size_t added;
+    //keys not in the new version
+    size_t removed;
+    //invalid lines and duplicate keys
+    size_t bad;
+
+    ReloadStats() : lines(0), unchanged(0), changed(0), added(0), removed(0), bad(0) {};
+};
+
+/**
+ * KeyedTable holds the rows of a tab separated dict by the key column
+ * reload() reads a new version of the dict, and hashes every raw line before any conversion;
+ * a line with the hash of the loaded row of its key is skipped,
+ * so only changed and new lines are parsed, and the keys not in the new version are removed
+ * the table ends the same as a full load of the new version
+ * it is changed in place, lookups must not run during reload()
+ * K is parsed from the raw key column by KeyParse, which must not depend on other columns
+ */
+template <typename K, typename R, typename KeyParse = Parse<K> >
+class KeyedTable {
+public:
+    /**
+     * @param [in] size_t key_column, index of the key column from 0
+    **/
+    explicit KeyedTable(size_t key_column = 0) : _key_column(key_column), _version(0) {};
+
+    /**
+     * @brief load a new version of the dict, the first reload loads every line
+     * @param [in] std::string path
+     * @param [in] LineParser* lp, the columns of a line, including the key column
+     * @param [in] RowFiller<R>* filler, called after lp parsed a changed or new line
+     * @return int
+     * @retval 0:succeed, -1:can not open the file, the table is not changed
+    **/
+    int reload(const std::string& path, LineParser* lp, RowFiller<R>* filler) {
+        std::ifstream fs(path.c_str(), std::ios::binary);
+        if (!fs.is_open()) {
+            return -1;
+        }
+        return reload(fs, lp, filler);
+    }
+
+    /**
+     * @brief load a new version of the dict from a stream
+     *        a read error before the end of the stream keeps every row not reached,
+     *        the rows read before it are already updated
+     * @param [in] std::istream fs
+     * @param [in] LineParser* lp
+     * @param [in] RowFiller<R>* filler
+     * @return int
+     * @retval 0:succeed, -1:read error, no row is removed
+    **/
+    int reload(std::istream& fs, LineParser* lp, RowFiller<R>* filler) {
+        _stats = ReloadStats();
+        _version++;
+        size_t seen = 0;
+        int ret = 0;
+        while ((ret = read_line(fs, _line, parse_limits().max_line_length, NULL)) <= 0) {
+            _stats.lines++;
+            if (ret != 0 || parse_key() != 0) {
+                bad_line("line format error");
+                continue;
+            }
+            uint64_t hash = hash_bytes(_line.data(), _line.size());
+            typename Rows::iterator it = _rows.find(_key);
+            if (it != _rows.end() && it->second.version == _version) {
+                bad_line("duplicate key");
+                continue;
+            }
+            if (it != _rows.end() && it->second.hash == hash) {
+                it->second.version = _version;
+                _stats.unchanged++;
+                seen++;
+                continue;
+            }
+            if (lp->parse(_line) != 0) {
+                bad_line("line format error");
+                continue;
+            }
+            if (it == _rows.end()) {
+                it = _rows.insert(std::make_pair(_key, Entry())).first;
+                _stats.added++;
+            } else {
+                _stats.changed++;
+            }
+            filler->fill(it->second.row);
+            it->second.hash = hash;
+            it->second.version = _version;
+            seen++;
+        }
+        //a failed read is not the end of the dict, the rows not reached are not removed;
+        //they keep an old version, and the next reload checks them again
+        if (fs.bad() || !fs.eof()) {
+            report_error(PARSE_ERROR_LINE, "read error, reload stopped");
+            return -1;
+        }
+        //every row left with an old version is not in the new dict
+        if (seen < _rows.size()) {
+            for (typename Rows::iterator it = _rows.begin(); it != _rows.end();) {
+                if (it->second.version != _version) {
+                    it = _rows.erase(it);
+                    _stats.removed++;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief find the row of a key
+     * @param [in] K key
+     * @return const R*
+     * @retval NULL:the key is not found
+    **/
+    const R* find(const K& key) const {
+        typename Rows::const_iterator it = _rows.find(key);
+        if (it == _rows.end()) {
+            return NULL;
+        }
+        return &it->second.row;
+    }
+
+    size_t size() const {
+        return _rows.size();
+    }
+
+    const ReloadStats& last_reload() const {
+        return _stats;
+    }
+
+private:
+    struct Entry {
+        //hash of the raw line of the row
+        uint64_t hash;
+        //the reload that saw the row last
+        uint64_t version;
+        R row;
+
+        Entry() : hash(0), version(0), row() {};
+    };
+    typedef std::unordered_map<K, Entry> Rows;
+
+    //parse the key column of _line to _key, the other columns are not touched
+    int parse_key() {
+        std::string::size_type begin = 0;
+        for (size_t i = 0; i < _key_column; i++) {
+            begin = _line.find('\t', begin);
+            if (begin == std::string::npos) {
+                return -1;
+            }
+            begin++;
+        }
+        std::string::size_type end = _line.find('\t', begin);
+        if (end == std::string::npos) {
+            end = _line.size();
+        }
+        _key_text.assign(_line, begin, end - begin);
+        try {
+            parse_to<KeyParse>(_key_text, _key);
+        } catch (std::exception& e) {
+            report_error(PARSE_ERROR_COLUMN, e.what());
+            return -1;
+        }
+        return 0;
+    }
+
+    void bad_line(const char* what) {
+        report_error(PARSE_ERROR_LINE, what);
+        _stats.bad++;
+    }
+
+    size_t _key_column;
+    uint64_t _version;
+    Rows _rows;
+    ReloadStats _stats;
+    //buffers of the current line, reused by every line
+    std::string _line;
+    std::string _key_text;
+    K _key;
+    DISALLOW_COPY_AND_ASSIGN(KeyedTable);
+};
+
+}
+#endif // GOODCODER_DELTA_RELOAD_H
@@ -0,0 +1,254 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test KeyedTable delta reload
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "delta_reload.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::Parse;
+using baidu::LineParser;
+using baidu::KeyedTable;
+using baidu::RowFiller;
+using baidu::ReloadStats;
+using baidu::hash_bytes;
+
+//the row of the table
+struct Row {
+    std::string name;
+    std::vector<float> weights;
+};
+
+//count the string columns converted
+static int g_conversions = 0;
+
+class CountParse {
+public:
+    std::string operator()(const std::string& s) const {
+        g_conversions++;
+        return s;
+    }
+};
+
+//parse 'id\tname\tweights' and fill a Row
+class Loader : public RowFiller<Row> {
+public:
+    Loader() {
+        lp.add_parser(&id);
+        lp.add_parser(&name);
+        lp.add_parser(&weights);
+    }
+
+    virtual void fill(Row& row) override {
+        row.name.swap(name.data());
+        row.weights.swap(weights.data());
+    }
+
+    Parser<int> id;
+    Parser<std::string, CountParse> name;
+    Parser<std::vector<float>> weights;
+    LineParser lp;
+};
+
+static std::string line_of(int id, const std::string& name) {
+    return std::to_string(id) + "\t" + name + "\t2:" + std::to_string(id) + ",0.5";
+}
+
+static void write_lines(const char* path, const std::vector<std::string>& lines) {
+    std::ofstream out(path);
+    for (size_t i = 0; i < lines.size(); i++) {
+        out << lines[i] << "\n";
+    }
+}
+
+//serves data, then fails as a broken disk or network file does
+class FailingBuf : public std::streambuf {
+public:
+    FailingBuf(const std::string& data, size_t fail_at) : _data(data), _pos(0),
+            _fail_at(fail_at) {};
+
+protected:
+    virtual int_type underflow() override {
+        if (_pos >= _fail_at) {
+            //the istream catches it and sets badbit
+            throw std::runtime_error("read error");
+        }
+        size_t n = std::min<size_t>(16, _fail_at - _pos);
+        char* p = &_data[_pos];
+        setg(p, p, p + n);
+        _pos += n;
+        return traits_type::to_int_type(*p);
+    }
+
+private:
+    std::string _data;
+    size_t _pos;
+    size_t _fail_at;
+};
+
+//test the hash of raw lines
+TEST(DeltaReload, hash) {
+    std::string a = "1\tabc\t2:1,0.5";
+    std::string b = "1\tabc\t2:1,0.6";
+    EXPECT_EQ(hash_bytes(a.data(), a.size()), hash_bytes(a.data(), a.size()));
+    EXPECT_NE(hash_bytes(a.data(), a.size()), hash_bytes(b.data(), b.size()));
+    EXPECT_NE(hash_bytes(a.data(), 8), hash_bytes(a.data(), 9));
+    EXPECT_NE(hash_bytes("", 0), hash_bytes("", 0, 1));
+}
+
+//test only the changed and new lines are converted
+TEST(DeltaReload, reload) {
+    const char* path = "delta_reload.txt";
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000; i++) {
+        lines.push_back(line_of(i, "name" + std::to_string(i)));
+    }
+    write_lines(path, lines);
+
+    KeyedTable<int, Row> table;
+    Loader loader;
+    g_conversions = 0;
+    ASSERT_EQ(table.reload(path, &loader.lp, &loader), 0);
+    EXPECT_EQ(table.size(), 1000);
+    EXPECT_EQ(table.last_reload().added, 1000);
+    EXPECT_EQ(g_conversions, 1000);
+    ASSERT_TRUE(table.find(10) != NULL);
+    EXPECT_STREQ(table.find(10)->name.c_str(), "name10");
+
+    //change 10 rows, remove 5 rows, add 3 rows and move a row
+    for (int i = 0; i < 10; i++) {
+        lines[i * 50] = line_of(i * 50, "changed");
+    }
+    lines.erase(lines.begin() + 995, lines.end());
+    for (int i = 0; i < 3; i++) {
+        lines.push_back(line_of(2000 + i, "new"));
+    }
+    std::swap(lines[1], lines[900]);
+    write_lines(path, lines);
+
+    g_conversions = 0;
+    ASSERT_EQ(table.reload(path, &loader.lp, &loader), 0);
+    const ReloadStats& stats = table.last_reload();
+    EXPECT_EQ(stats.lines, 998);
+    EXPECT_EQ(stats.changed, 10);
+    EXPECT_EQ(stats.added, 3);
+    EXPECT_EQ(stats.removed, 5);
+    EXPECT_EQ(stats.unchanged, 985);
+    EXPECT_EQ(stats.bad, 0);
+    EXPECT_EQ(g_conversions, 13);
+
+    EXPECT_EQ(table.size(), 998);
+    EXPECT_STREQ(table.find(50)->name.c_str(), "changed");
+    EXPECT_STREQ(table.find(51)->name.c_str(), "name51");
+    ASSERT_EQ(table.find(51)->weights.size(), 2);
+    EXPECT_FLOAT_EQ(table.find(51)->weights[0], 51);
+    EXPECT_STREQ(table.find(2001)->name.c_str(), "new");
+    EXPECT_TRUE(table.find(999) == NULL);
+
+    //the same version again converts nothing
+    g_conversions = 0;
+    ASSERT_EQ(table.reload(path, &loader.lp, &loader), 0);
+    EXPECT_EQ(table.last_reload().unchanged, 998);
+    EXPECT_EQ(g_conversions, 0);
+
+    EXPECT_EQ(table.reload("no.txt", &loader.lp, &loader), -1);
+    EXPECT_EQ(table.size(), 998);
+    remove(path);
+}
+
+//test a read error keeps the rows not reached
+TEST(DeltaReload, read_error) {
+    const char* path = "delta_reload_error.txt";
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000; i++) {
+        lines.push_back(line_of(i, "name" + std::to_string(i)));
+    }
+    write_lines(path, lines);
+    KeyedTable<int, Row> table;
+    Loader loader;
+    ASSERT_EQ(table.reload(path, &loader.lp, &loader), 0);
+    ASSERT_EQ(table.size(), 1000);
+
+    //the new version fails after 100 lines
+    std::string data;
+    for (int i = 0; i < 1000; i++) {
+        data += line_of(i, "changed") + "\n";
+    }
+    size_t fail_at = 0;
+    for (int i = 0; i < 100; i++) {
+        fail_at = data.find('\n', fail_at) + 1;
+    }
+    FailingBuf buf(data, fail_at);
+    std::istream is(&buf);
+    EXPECT_EQ(table.reload(is, &loader.lp, &loader), -1);
+    EXPECT_EQ(table.last_reload().removed, 0);
+    EXPECT_EQ(table.size(), 1000);
+    EXPECT_STREQ(table.find(99)->name.c_str(), "changed");
+    ASSERT_TRUE(table.find(999) != NULL);
+    EXPECT_STREQ(table.find(999)->name.c_str(), "name999");
+
+    //the next good reload ends as a full load
+    ASSERT_EQ(table.reload(path, &loader.lp, &loader), 0);
+    EXPECT_EQ(table.size(), 1000);
+    EXPECT_EQ(table.last_reload().changed, 100);
+    EXPECT_STREQ(table.find(99)->name.c_str(), "name99");
+    remove(path);
+}
+
+//test invalid lines and duplicate keys end as a full load does
+TEST(DeltaReload, bad_lines) {
+    const char* path = "delta_reload_bad.txt";
+    std::vector<std::string> lines;
+    lines.push_back(line_of(1, "a"));
+    lines.push_back(line_of(2, "b"));
+    lines.push_back(line_of(3, "c"));
+    write_lines(path, lines);
+
+    KeyedTable<int, Row> table;
+    Loader loader;
+    ASSERT_EQ(table.reload(path, &loader.lp, &loader), 0);
+    EXPECT_EQ(table.size(), 3);
+
+    //row 2 becomes invalid, row 3 is duplicate, the key of a line is invalid
+    lines[1] = "2\tb\t2:x,y";
+    lines.push_back(line_of(3, "d"));
+    lines.push_back("x\ty\t1:1");
+    write_lines(path, lines);
+    ASSERT_EQ(table.reload(path, &loader.lp, &loader), 0);
+    EXPECT_EQ(table.last_reload().bad, 3);
+    EXPECT_EQ(table.last_reload().removed, 1);
+    EXPECT_EQ(table.size(), 2);
+    EXPECT_TRUE(table.find(2) == NULL);
+    EXPECT_STREQ(table.find(3)->name.c_str(), "c");
+
+    //a string key in the second column
+    KeyedTable<std::string, Row> by_name(1);
+    ASSERT_EQ(by_name.reload(path, &loader.lp, &loader), 0);
+    EXPECT_EQ(by_name.size(), 3);
+    ASSERT_TRUE(by_name.find("d") != NULL);
+    EXPECT_FLOAT_EQ(by_name.find("d")->weights[0], 3);
+    remove(path);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,480 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// dictstat: profile the load of a dict, prints the time of every stage and column,
+// the error rate of every column, row and column length distributions,
+// and the throughput of the engines side by side
+// usage : dictstat [-m stream,mmap,parallel|all] [-t threads] [-c chunk_lines] dict schema
+//         schema is the types of the columns, e.g. int,float,string,float_array
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parser.h"
+#include "line_index.h"
+#include "load_stats.h"
+#include "parallel_parser.h"
+
+namespace {
+
+using baidu::ParserBase;
+using baidu::Parser;
+using baidu::LengthStats;
+using baidu::Histogram;
+
+typedef std::chrono::steady_clock Clock;
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start).count() / 1000.0;
+}
+
+//the types a schema may use
+const char* const TYPE_NAMES[] = {
+    "int", "float", "double", "string", "int_array", "float_array", "double_array"
+};
+
+/**
+ * @brief create the Parser of a column type
+ * @param [in] std::string type, one of TYPE_NAMES
+ * @return ParserBase*
+ * @retval NULL:unknown type
+**/
+ParserBase* create_column(const std::string& type) {
+    if (type == "int") {
+        return new Parser<int>();
+    } else if (type == "float") {
+        return new Parser<float>();
+    } else if (type == "double") {
+        return new Parser<double>();
+    } else if (type == "string") {
+        return new Parser<std::string>();
+    } else if (type == "int_array") {
+        return new Parser<std::vector<int>>();
+    } else if (type == "float_array") {
+        return new Parser<std::vector<float>>();
+    } else if (type == "double_array") {
+        return new Parser<std::vector<double>>();
+    }
+    return NULL;
+}
+
+/**
+ * Columns owns the Parser objects of a schema
+ * every engine or worker needs its own Columns
+ */
+class Columns {
+public:
+    explicit Columns(const std::vector<std::string>& schema) {
+        for (size_t i = 0; i < schema.size(); i++) {
+            _v.push_back(create_column(schema[i]));
+        }
+    }
+
+    ~Columns() {
+        for (size_t i = 0; i < _v.size(); i++) {
+            delete _v[i];
+        }
+    }
+
+    size_t size() const {
+        return _v.size();
+    }
+
+    ParserBase* at(size_t i) {
+        return _v[i];
+    }
+
+    template <typename Target>
+    void add_to(Target* target, int (Target::*add)(ParserBase*)) {
+        for (size_t i = 0; i < _v.size(); i++) {
+            (target->*add)(_v[i]);
+        }
+    }
+
+private:
+    std::vector<ParserBase*> _v;
+    DISALLOW_COPY_AND_ASSIGN(Columns);
+};
+
+//count the valid rows
+class Counter : public baidu::RowVisitor {
+public:
+    Counter() : count(0) {};
+    virtual void visit() override {
+        count++;
+    }
+    size_t count;
+};
+
+//count the errors instead of logging every one of them
+class CountSink : public baidu::ErrorSink {
+public:
+    CountSink() : lines(0), columns(0) {};
+    virtual void report(baidu::ParseError error, const char* /*what*/) override {
+        if (error == baidu::PARSE_ERROR_LINE) {
+            lines.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            columns.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    std::atomic<uint64_t> lines;
+    std::atomic<uint64_t> columns;
+};
+
+/**
+ * @brief profile the stages of a load, chunk by chunk:
+ *        read chunk_lines lines, split all of them, then convert one column at a time,
+ *        so every stage is timed without a clock call for every column
+ * @return int
+ * @retval 0:succeed, -1:can not open the dict
+**/
+int profile(const std::string& path, const std::vector<std::string>& schema, size_t chunk_lines) {
+    std::ifstream fs(path.c_str(), std::ios::binary);
+    if (!fs.is_open()) {
+        fprintf(stderr, "can not open %s\n", path.c_str());
+        return -1;
+    }
+    size_t column_num = schema.size();
+    Columns columns(schema);
+    std::vector<std::string> lines(chunk_lines);
+    //cells[c][i] is column c of line i of the chunk
+    std::vector<std::vector<std::string> > cells(column_num, std::vector<std::string>(chunk_lines));
+    //the line has the columns of the schema
+    std::vector<char> row_split(chunk_lines);
+    //the line has no invalid column
+    std::vector<char> row_ok(chunk_lines);
+
+    double io_ms = 0;
+    double split_ms = 0;
+    std::vector<double> convert_ms(column_num, 0);
+    std::vector<uint64_t> column_errors(column_num, 0);
+    std::vector<LengthStats> column_lengths(column_num);
+    Histogram row_bytes;
+    std::map<size_t, uint64_t> row_columns;
+    uint64_t total_lines = 0;
+    uint64_t too_long = 0;
+    uint64_t split_rows = 0;
+    uint64_t good = 0;
+    uint64_t bytes = 0;
+
+    bool end = false;
+    while (!end) {
+        Clock::time_point start = Clock::now();
+        size_t n = 0;
+        while (n < chunk_lines) {
+            size_t consumed = 0;
+            int ret = baidu::read_line(fs, lines[n], baidu::parse_limits().max_line_length,
+                    &consumed);
+            if (ret > 0) {
+                end = true;
+                break;
+            }
+            bytes += consumed;
+            total_lines++;
+            if (ret < 0) {
+                too_long++;
+                continue;
+            }
+            n++;
+        }
+        io_ms += ms_since(start);
+
+        start = Clock::now();
+        for (size_t i = 0; i < n; i++) {
+            const std::string& line = lines[i];
+            std::string::size_type begin = 0;
+            size_t c = 0;
+            while (begin < line.size()) {
+                std::string::size_type pos = line.find('\t', begin);
+                if (pos == std::string::npos) {
+                    pos = line.size();
+                }
+                if (c < column_num) {
+                    cells[c][i].assign(line, begin, pos - begin);
+                }
+                c++;
+                begin = pos + 1;
+            }
+            row_split[i] = (c == column_num);
+            row_ok[i] = row_split[i];
+            row_columns[c]++;
+        }
+        split_ms += ms_since(start);
+
+        for (size_t c = 0; c < column_num; c++) {
+            ParserBase* column = columns.at(c);
+            start = Clock::now();
+            //every cell of a split row is converted, even after an invalid cell of the row,
+            //so the error rate of a column is not hidden by the columns before it
+            for (size_t i = 0; i < n; i++) {
+                if (row_split[i] && column->parse(cells[c][i]) != 0) {
+                    column_errors[c]++;
+                    row_ok[i] = 0;
+                }
+            }
+            convert_ms[c] += ms_since(start);
+        }
+
+        //distributions are not part of the timed stages
+        for (size_t i = 0; i < n; i++) {
+            row_bytes.add(lines[i].size());
+            if (row_split[i]) {
+                split_rows++;
+            }
+            if (row_ok[i]) {
+                good++;
+            }
+        }
+        for (size_t c = 0; c < column_num; c++) {
+            for (size_t i = 0; i < n; i++) {
+                if (row_split[i]) {
+                    column_lengths[c].add(cells[c][i].size());
+                }
+            }
+        }
+    }
+
+    double convert_total = 0;
+    size_t dominant = 0;
+    for (size_t c = 0; c < column_num; c++) {
+        convert_total += convert_ms[c];
+        if (convert_ms[c] > convert_ms[dominant]) {
+            dominant = c;
+        }
+    }
+    double total_ms = io_ms + split_ms + convert_total;
+
+    printf("dict: %s\n", path.c_str());
+    printf("lines: %llu, split rows: %llu, valid: %llu, too long: %llu, bytes: %llu\n",
+            static_cast<unsigned long long>(total_lines),
+            static_cast<unsigned long long>(split_rows), static_cast<unsigned long long>(good),
+            static_cast<unsigned long long>(too_long), static_cast<unsigned long long>(bytes));
+    printf("\nstage          ms        share\n");
+    printf("  io      %10.2f  %6.2f%%\n", io_ms, total_ms == 0 ? 0 : 100 * io_ms / total_ms);
+    printf("  split   %10.2f  %6.2f%%\n", split_ms,
+            total_ms == 0 ? 0 : 100 * split_ms / total_ms);
+    printf("  convert %10.2f  %6.2f%%\n", convert_total,
+            total_ms == 0 ? 0 : 100 * convert_total / total_ms);
+
+    //every column converts the cells of all split rows, so they are the denominator
+    printf("\ncolumn type           convert ms  share   errors   errors/split rows"
+            "  len min   avg     p50   p99   max\n");
+    for (size_t c = 0; c < column_num; c++) {
+        const LengthStats& len = column_lengths[c];
+        printf("  %-3zu %-14s %10.2f %6.2f%% %8llu %16.4f%%  %6zu %7.1f %6zu %5zu %6zu\n",
+                c, schema[c].c_str(), convert_ms[c],
+                convert_total == 0 ? 0 : 100 * convert_ms[c] / convert_total,
+                static_cast<unsigned long long>(column_errors[c]),
+                split_rows == 0 ? 0 : 100.0 * column_errors[c] / split_rows,
+                len.min(), len.average(), len.percentile(0.5), len.percentile(0.99), len.max());
+    }
+    if (column_num > 0 && convert_total > 0) {
+        printf("dominant column kernel: %zu (%s), %.2f%% of conversion\n", dominant,
+                schema[dominant].c_str(), 100 * convert_ms[dominant] / convert_total);
+    }
+
+    printf("\n");
+    row_bytes.print("row bytes", total_lines - too_long);
+    printf("columns per row\n");
+    for (std::map<size_t, uint64_t>::const_iterator it = row_columns.begin();
+            it != row_columns.end(); ++it) {
+        printf("  %8zu %10llu%s\n", it->first, static_cast<unsigned long long>(it->second),
+                it->first == column_num ? "" : "  (mismatch)");
+    }
+    return 0;
+}
+
+//throughput of one engine
+struct ModeResult {
+    std::string mode;
+    size_t threads;
+    uint64_t good;
+    uint64_t bad;
+    double ms;
+    //time to build the line index, mmap only
+    double prepare_ms;
+};
+
+/**
+ * @brief load the whole dict with an engine
+ * @param [in] std::string mode, stream, mmap or parallel
+ * @return int
+ * @retval 0:succeed, -1:unknown mode or can not open the dict
+**/
+int run_mode(const std::string& mode, const std::string& path,
+        const std::vector<std::string>& schema, size_t threads, ModeResult* result) {
+    CountSink sink;
+    baidu::set_error_sink(&sink);
+    result->mode = mode;
+    result->threads = 1;
+    result->prepare_ms = 0;
+    int ret = 0;
+    Clock::time_point start = Clock::now();
+    if (mode == "stream") {
+        Columns columns(schema);
+        baidu::DictParser dp(path);
+        columns.add_to(&dp, &baidu::DictParser::add_column);
+        Counter counter;
+        result->good = dp.parse_all(&counter);
+        result->bad = sink.lines;
+    } else if (mode == "mmap") {
+        baidu::LineIndex index;
+        if (index.build(path, 1024) != 0) {
+            ret = -1;
+        }
+        result->prepare_ms = ms_since(start);
+        Columns columns(schema);
+        baidu::MappedDict md(path);
+        columns.add_to(&md, &baidu::MappedDict::add_column);
+        Counter counter;
+        result->good = (ret == 0) ? md.parse_lines(index, 0, index.lines(), &counter) : 0;
+        result->bad = sink.lines;
+    } else if (mode == "parallel") {
+        result->threads = threads;
+        baidu::ParallelDictParser pdp(path);
+        std::vector<Columns*> columns;
+        std::vector<baidu::LineParser*> parsers;
+        std::vector<Counter*> counters;
+        for (size_t i = 0; i < threads; i++) {
+            columns.push_back(new Columns(schema));
+            parsers.push_back(new baidu::LineParser());
+            counters.push_back(new Counter());
+            columns[i]->add_to(parsers[i], &baidu::LineParser::add_parser);
+            pdp.add_worker(parsers[i], counters[i]);
+        }
+        ret = pdp.parse();
+        result->good = pdp.good_lines();
+        result->bad = pdp.bad_lines();
+        for (size_t i = 0; i < threads; i++) {
+            delete columns[i];
+            delete parsers[i];
+            delete counters[i];
+        }
+    } else {
+        fprintf(stderr, "unknown mode %s\n", mode.c_str());
+        ret = -1;
+    }
+    result->ms = ms_since(start);
+    baidu::set_error_sink(NULL);
+    return ret;
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> v;
+    std::string::size_type begin = 0;
+    while (begin <= s.size()) {
+        std::string::size_type end = s.find(sep, begin);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        v.push_back(s.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return v;
+}
+
+void usage() {
+    fprintf(stderr, "usage: dictstat [-m stream,mmap,parallel|all] [-t threads] "
+            "[-c chunk_lines] dict schema\n");
+    fprintf(stderr, "  schema: column types separated by ',', types are");
+    for (size_t i = 0; i < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); i++) {
+        fprintf(stderr, " %s", TYPE_NAMES[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string modes = "stream";
+    size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t chunk_lines = 4096;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "m:t:c:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            modes = optarg;
+            break;
+        case 't':
+            threads = std::max(atoi(optarg), 1);
+            break;
+        case 'c':
+            chunk_lines = std::max(atoi(optarg), 1);
+            break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
+        return 1;
+    }
+    std::string path = argv[optind];
+    std::vector<std::string> schema = split(argv[optind + 1], ',');
+    for (size_t i = 0; i < schema.size(); i++) {
+        ParserBase* column = create_column(schema[i]);
+        if (column == NULL) {
+            fprintf(stderr, "unknown column type '%s'\n", schema[i].c_str());
+            usage();
+            return 1;
+        }
+        delete column;
+    }
+    if (modes == "all") {
+        modes = "stream,mmap,parallel";
+    }
+
+    CountSink sink;
+    baidu::set_error_sink(&sink);
+    int ret = profile(path, schema, chunk_lines);
+    baidu::set_error_sink(NULL);
+    if (ret != 0) {
+        return 1;
+    }
+
+    struct stat st;
+    double mb = (stat(path.c_str(), &st) == 0) ? st.st_size / 1048576.0 : 0;
+    std::vector<std::string> mode_list = split(modes, ',');
+    std::vector<ModeResult> results;
+    for (size_t i = 0; i < mode_list.size(); i++) {
+        ModeResult result;
+        if (run_mode(mode_list[i], path, schema, threads, &result) != 0) {
+            return 1;
+        }
+        results.push_back(result);
+    }
+
+    printf("\nengine     threads       valid        bad    load ms  prepare ms"
+            "     MB/s      rows/s\n");
+    size_t fastest = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        const ModeResult& r = results[i];
+        double seconds = r.ms / 1000;
+        printf("  %-9s %7zu %11llu %10llu %10.2f %11.2f %8.1f %11.0f\n", r.mode.c_str(),
+                r.threads, static_cast<unsigned long long>(r.good),
+                static_cast<unsigned long long>(r.bad), r.ms, r.prepare_ms,
+                seconds == 0 ? 0 : mb / seconds, seconds == 0 ? 0 : r.good / seconds);
+        if (r.ms < results[fastest].ms) {
+            fastest = i;
+        }
+    }
+    if (results.size() > 1) {
+        printf("fastest engine: %s\n", results[fastest].mode.c_str());
+    }
+    return 0;
+}
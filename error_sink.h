@@ -0,0 +1,277 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// AsyncErrorSink samples parse errors into per-thread buffers and forwards them from a thread
+
+#ifndef GOODCODER_ERROR_SINK_H
+#define GOODCODER_ERROR_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "parser.h"
+#include "row_queue.h"
+
+namespace baidu {
+
+/**
+ * AsyncErrorSink keeps parse threads away from the lock of the target sink
+ * every thread counts its own errors and buffers the sampled ones in its own lock-free queue:
+ * the first first_n errors, then one of every every_k errors
+ * an aggregator thread forwards the buffered errors to the target sink
+ * errors not sampled cost a counter increment only, nothing is formatted or copied;
+ * when the buffer of a thread is full, the error is dropped instead of waiting
+ * a buffer is recycled when its thread exits, so there are not more buffers
+ * than threads that have reported errors and are alive at the same time
+ * usage:
+ *   AsyncErrorSink sink(error_sink(), 100, 10000);
+ *   set_error_sink(&sink);
+ *   ...parse...
+ *   set_error_sink(NULL); //after the parse threads end
+ */
+class AsyncErrorSink : public ErrorSink {
+public:
+    /**
+     * @param [in] ErrorSink* target, called by the aggregator thread only
+     * @param [in] size_t first_n, errors of every thread forwarded before sampling
+     * @param [in] size_t every_k, forward one of every every_k later errors, 0 for none
+     * @param [in] size_t buffer_size, errors buffered for every thread
+     * @param [in] int64_t interval_ms, the aggregator forwards the buffers every interval_ms
+    **/
+    AsyncErrorSink(ErrorSink* target, size_t first_n, size_t every_k,
+            size_t buffer_size = 1024, int64_t interval_ms = 100) :
+            _target(target), _first_n(first_n), _every_k(every_k),
+            _buffer_size(buffer_size), _interval_ms(interval_ms),
+            _id(next_id()), _forwarded(0), _stop(false) {
+        {
+            LiveSinks& live = live_sinks();
+            std::lock_guard<std::mutex> lock(live.mutex);
+            live.ids.insert(_id);
+        }
+        _aggregator = std::thread(&AsyncErrorSink::aggregate, this);
+    }
+
+    //forward the buffered errors and stop the aggregator thread
+    virtual ~AsyncErrorSink() {
+        ErrorSink* self = this;
+        error_sink_holder().compare_exchange_strong(self, default_error_sink());
+        {
+            //exiting threads do not return their buffers any more
+            LiveSinks& live = live_sinks();
+            std::lock_guard<std::mutex> lock(live.mutex);
+            live.ids.erase(_id);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_stop_mutex);
+            _stop = true;
+        }
+        _stop_cv.notify_one();
+        _aggregator.join();
+        flush();
+        for (size_t i = 0; i < _buffers.size(); i++) {
+            delete _buffers[i];
+        }
+    }
+
+    virtual void report(ParseError error, const char* what) override {
+        ThreadBuffer* buffer = local_buffer();
+        //only this thread writes its counters, no locked instruction is needed
+        uint64_t n = buffer->errors.load(std::memory_order_relaxed);
+        buffer->errors.store(n + 1, std::memory_order_relaxed);
+        n -= buffer->base;
+        if (n >= _first_n && (_every_k == 0 || (n - _first_n + 1) % _every_k != 0)) {
+            return;
+        }
+        Message message;
+        message.error = error;
+        size_t len = strnlen(what, sizeof(message.what) - 1);
+        memcpy(message.what, what, len);
+        message.what[len] = '\0';
+        if (!buffer->queue.try_push(message)) {
+            uint64_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+            buffer->dropped.store(dropped + 1, std::memory_order_relaxed);
+        }
+    }
+
+    //forward the buffered errors now
+    void flush() {
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock(_buffers_mutex);
+            buffers = _buffers;
+        }
+        std::lock_guard<std::mutex> lock(_flush_mutex);
+        Message message;
+        for (size_t i = 0; i < buffers.size(); i++) {
+            while (buffers[i]->queue.try_pop(&message)) {
+                _target->report(message.error, message.what);
+                _forwarded.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    //errors reported by all threads
+    uint64_t errors() const {
+        return sum(&ThreadBuffer::errors);
+    }
+
+    //errors forwarded to the target
+    uint64_t forwarded() const {
+        return _forwarded.load(std::memory_order_relaxed);
+    }
+
+    //sampled errors dropped because a buffer was full
+    uint64_t dropped() const {
+        return sum(&ThreadBuffer::dropped);
+    }
+
+    //buffers of all threads, a buffer is reused after its thread exits
+    size_t buffer_count() const {
+        std::lock_guard<std::mutex> lock(_buffers_mutex);
+        return _buffers.size();
+    }
+
+private:
+    struct Message {
+        ParseError error;
+        char what[120];
+    };
+
+    //owned by one parse thread at a time
+    struct ThreadBuffer {
+        explicit ThreadBuffer(size_t size) :
+                queue(size), errors(0), dropped(0), in_use(true), base(0) {};
+        BoundedQueue<Message> queue;
+        std::atomic<uint64_t> errors;
+        std::atomic<uint64_t> dropped;
+        //guarded by _buffers_mutex
+        bool in_use;
+        //errors of the former threads of this buffer, the owner samples from here
+        uint64_t base;
+    };
+
+    //the ids of the sinks not destroyed yet
+    struct LiveSinks {
+        std::mutex mutex;
+        std::unordered_set<uint64_t> ids;
+    };
+
+    static LiveSinks& live_sinks() {
+        static LiveSinks sinks;
+        return sinks;
+    }
+
+    //the buffer held by a thread, returned to its sink when the thread exits
+    struct LocalBuffer {
+        uint64_t owner;
+        AsyncErrorSink* sink;
+        ThreadBuffer* buffer;
+
+        LocalBuffer() : owner(0), sink(NULL), buffer(NULL) {};
+
+        ~LocalBuffer() {
+            release();
+        }
+
+        void release() {
+            if (buffer == NULL) {
+                return;
+            }
+            LiveSinks& live = live_sinks();
+            std::lock_guard<std::mutex> lock(live.mutex);
+            if (live.ids.count(owner) != 0) {
+                std::lock_guard<std::mutex> buffers_lock(sink->_buffers_mutex);
+                buffer->in_use = false;
+            }
+            owner = 0;
+            sink = NULL;
+            buffer = NULL;
+        }
+    };
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> id(1);
+        return id.fetch_add(1);
+    }
+
+    //the buffer of this thread, registered at the first error of the thread
+    ThreadBuffer* local_buffer() {
+        static thread_local LocalBuffer local;
+        if (local.owner != _id) {
+            local.release();
+            local.buffer = register_thread();
+            local.sink = this;
+            local.owner = _id;
+        }
+        return local.buffer;
+    }
+
+    //take a buffer left by an exited thread, or a new one
+    ThreadBuffer* register_thread() {
+        std::lock_guard<std::mutex> lock(_buffers_mutex);
+        for (size_t i = 0; i < _buffers.size(); i++) {
+            if (!_buffers[i]->in_use) {
+                _buffers[i]->in_use = true;
+                _buffers[i]->base = _buffers[i]->errors.load(std::memory_order_relaxed);
+                return _buffers[i];
+            }
+        }
+        ThreadBuffer* buffer = new ThreadBuffer(_buffer_size);
+        _buffers.push_back(buffer);
+        return buffer;
+    }
+
+    uint64_t sum(std::atomic<uint64_t> ThreadBuffer::* counter) const {
+        std::lock_guard<std::mutex> lock(_buffers_mutex);
+        uint64_t total = 0;
+        for (size_t i = 0; i < _buffers.size(); i++) {
+            total += (_buffers[i]->*counter).load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    void aggregate() {
+        std::unique_lock<std::mutex> lock(_stop_mutex);
+        while (!_stop) {
+            _stop_cv.wait_for(lock, std::chrono::milliseconds(_interval_ms), [this]() {
+                return _stop;
+            });
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    ErrorSink* _target;
+    size_t _first_n;
+    size_t _every_k;
+    size_t _buffer_size;
+    int64_t _interval_ms;
+    //tells the thread_local buffer of this sink from the one of an old sink
+    uint64_t _id;
+    std::atomic<uint64_t> _forwarded;
+
+    //taken when a thread reports its first error, not for every error
+    mutable std::mutex _buffers_mutex;
+    std::vector<ThreadBuffer*> _buffers;
+    //the aggregator and flush() may forward at the same time
+    std::mutex _flush_mutex;
+
+    std::mutex _stop_mutex;
+    std::condition_variable _stop_cv;
+    bool _stop;
+    std::thread _aggregator;
+    DISALLOW_COPY_AND_ASSIGN(AsyncErrorSink);
+};
+
+}
+#endif // GOODCODER_ERROR_SINK_H
@@ -0,0 +1,221 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test ErrorSink and AsyncErrorSink
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "error_sink.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::DictParser;
+using baidu::ErrorSink;
+using baidu::AsyncErrorSink;
+using baidu::ParseError;
+using baidu::PARSE_ERROR_COLUMN;
+using baidu::PARSE_ERROR_LINE;
+using baidu::error_sink;
+using baidu::set_error_sink;
+using baidu::default_error_sink;
+
+//keep every error
+class CollectSink : public ErrorSink {
+public:
+    virtual void report(ParseError error, const char* what) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        errors.push_back(error);
+        whats.push_back(what);
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return errors.size();
+    }
+
+    std::vector<ParseError> errors;
+    std::vector<std::string> whats;
+private:
+    std::mutex _mutex;
+};
+
+//do nothing for a row
+class Skip : public baidu::RowVisitor {
+public:
+    virtual void visit() override {}
+};
+
+//test replacing the sink
+TEST(ErrorSink, set) {
+    EXPECT_EQ(error_sink(), default_error_sink());
+    CollectSink sink;
+    set_error_sink(&sink);
+
+    Parser<int> p0;
+    LineParser lp;
+    lp.add_parser(&p0);
+    EXPECT_EQ(lp.parse("abc"), -1);
+
+    const char* path = "error_sink.txt";
+    std::ofstream out(path);
+    out << "1\nx\n2\n";
+    out.close();
+    DictParser dp(path);
+    dp.add_column(&p0);
+    Skip skip;
+    EXPECT_EQ(dp.parse_all(&skip), 2);
+
+    set_error_sink(NULL);
+    EXPECT_EQ(error_sink(), default_error_sink());
+    ASSERT_EQ(sink.errors.size(), 3);
+    EXPECT_EQ(sink.errors[0], PARSE_ERROR_COLUMN);
+    EXPECT_STREQ(sink.whats[0].c_str(), "stoi");
+    EXPECT_EQ(sink.errors[1], PARSE_ERROR_COLUMN);
+    EXPECT_EQ(sink.errors[2], PARSE_ERROR_LINE);
+    remove(path);
+}
+
+//test the first n errors and then every k-th error are forwarded
+TEST(AsyncErrorSink, sample) {
+    CollectSink target;
+    AsyncErrorSink sink(&target, 3, 10);
+    for (int i = 0; i < 100; i++) {
+        sink.report(PARSE_ERROR_COLUMN, std::to_string(i).c_str());
+    }
+    sink.flush();
+    EXPECT_EQ(sink.errors(), 100);
+    EXPECT_EQ(sink.forwarded(), 12);
+    EXPECT_EQ(sink.dropped(), 0);
+    ASSERT_EQ(target.size(), 12);
+    EXPECT_STREQ(target.whats[2].c_str(), "2");
+    EXPECT_STREQ(target.whats[3].c_str(), "12");
+    EXPECT_STREQ(target.whats[11].c_str(), "92");
+
+    //long messages are cut
+    sink.report(PARSE_ERROR_LINE, std::string(1000, 'x').c_str());
+    sink.report(PARSE_ERROR_LINE, std::string(1000, 'x').c_str());
+    sink.report(PARSE_ERROR_LINE, std::string(1000, 'x').c_str());
+    sink.flush();
+    ASSERT_EQ(target.size(), 13);
+    EXPECT_EQ(target.whats[12].size(), 119);
+    EXPECT_EQ(target.errors[12], PARSE_ERROR_LINE);
+}
+
+//test a full buffer drops errors instead of waiting
+TEST(AsyncErrorSink, full_buffer) {
+    CollectSink target;
+    {
+        //the aggregator does not run before the sink is destroyed
+        AsyncErrorSink sink(&target, 100, 0, 4, 3600 * 1000);
+        for (int i = 0; i < 10; i++) {
+            sink.report(PARSE_ERROR_COLUMN, "bad");
+        }
+        EXPECT_EQ(sink.errors(), 10);
+        EXPECT_EQ(sink.dropped(), 6);
+        EXPECT_EQ(target.size(), 0);
+    }
+    //forwarded when destroyed
+    EXPECT_EQ(target.size(), 4);
+}
+
+//test parse threads report to their own buffers
+TEST(AsyncErrorSink, threads) {
+    CollectSink target;
+    AsyncErrorSink* sink = new AsyncErrorSink(&target, 5, 1000, 1024, 1);
+    set_error_sink(sink);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([]() {
+            Parser<int> p0;
+            LineParser lp;
+            lp.add_parser(&p0);
+            for (int i = 0; i < 10000; i++) {
+                lp.parse("bad");
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    sink->flush();
+    EXPECT_EQ(sink->errors(), 40000);
+    EXPECT_EQ(sink->dropped(), 0);
+    //5 + 9 for every thread
+    EXPECT_EQ(sink->forwarded(), 56);
+    EXPECT_EQ(target.size(), 56);
+
+    //a destroyed sink is not used any more
+    delete sink;
+    EXPECT_EQ(error_sink(), default_error_sink());
+
+    CollectSink target1;
+    AsyncErrorSink sink1(&target1, 1, 0);
+    sink1.report(PARSE_ERROR_COLUMN, "first");
+    sink1.report(PARSE_ERROR_COLUMN, "second");
+    sink1.flush();
+    EXPECT_EQ(sink1.errors(), 2);
+    EXPECT_EQ(target1.size(), 1);
+}
+
+
+//test the buffer of an exited thread is reused, and sampled from its new thread
+TEST(AsyncErrorSink, recycle) {
+    CollectSink target;
+    AsyncErrorSink sink(&target, 2, 0);
+    for (int t = 0; t < 50; t++) {
+        std::thread thread([&sink]() {
+            for (int i = 0; i < 10; i++) {
+                sink.report(PARSE_ERROR_COLUMN, "bad");
+            }
+        });
+        thread.join();
+    }
+    EXPECT_EQ(sink.buffer_count(), 1);
+    sink.flush();
+    EXPECT_EQ(sink.errors(), 500);
+    EXPECT_EQ(sink.forwarded(), 100);
+
+    //threads alive at the same time hold their own buffers
+    std::vector<std::thread> threads;
+    std::atomic<int> reported(0);
+    std::atomic<bool> done(false);
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&sink, &reported, &done]() {
+            sink.report(PARSE_ERROR_LINE, "bad");
+            reported++;
+            while (!done) {
+                std::this_thread::yield();
+            }
+        }));
+    }
+    while (reported < 4) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(sink.buffer_count(), 4);
+    done = true;
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    sink.flush();
+    EXPECT_EQ(sink.forwarded(), 104);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
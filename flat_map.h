@@ -0,0 +1,159 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// FlatMap is a map column stored in a sorted vector, MapParse parses 'num:k:v,k:v' into it
+
+#ifndef GOODCODER_FLAT_MAP_H
+#define GOODCODER_FLAT_MAP_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parser.h"
+
+namespace baidu {
+
+/**
+ * FlatMap is a read-only map kept in one sorted vector of pairs,
+ * find is a binary search, there is no node or pointer for every item
+ * it is built by MapParse, so the same vector is reused by every line
+ */
+template <typename K, typename V>
+class FlatMap {
+public:
+    typedef std::pair<K, V> value_type;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    /**
+     * @brief find the value of a key
+     * @param [in] K k
+     * @return const V*
+     * @retval NULL:the key is not found
+    **/
+    const V* find(const K& k) const {
+        const_iterator it = std::lower_bound(_items.begin(), _items.end(), k, KeyLess());
+        if (it == _items.end() || k < it->first) {
+            return NULL;
+        }
+        return &it->second;
+    }
+
+    size_t size() const {
+        return _items.size();
+    }
+
+    bool empty() const {
+        return _items.empty();
+    }
+
+    const_iterator begin() const {
+        return _items.begin();
+    }
+
+    const_iterator end() const {
+        return _items.end();
+    }
+
+    //items in any order, call sort_unique() after filling them
+    std::vector<value_type>& items() {
+        return _items;
+    }
+
+    /**
+     * @brief sort the items by key
+     * @return int
+     * @retval 0:succeed, -1:duplicate keys
+    **/
+    int sort_unique() {
+        KeyLess less;
+        if (!std::is_sorted(_items.begin(), _items.end(), less)) {
+            std::sort(_items.begin(), _items.end(), less);
+        }
+        for (size_t i = 1; i < _items.size(); i++) {
+            if (!less(_items[i - 1], _items[i])) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+private:
+    struct KeyLess {
+        bool operator()(const value_type& a, const value_type& b) const {
+            return a.first < b.first;
+        }
+        bool operator()(const value_type& a, const K& k) const {
+            return a.first < k;
+        }
+    };
+
+    std::vector<value_type> _items;
+};
+
+/**
+ * MapParse parses a 'num:k1:v1,k2:v2' column into FlatMap<K, V>
+ * ItemSep, KvSep and CountSep replace ',', ':' and ':'
+ * keys and values are parsed by KeyParse and ValueParse, into the items of the last line
+ * when they can, so a map of strings keeps the memory of its strings
+ */
+template <typename K, typename V, char ItemSep = ',', char KvSep = ':', char CountSep = ':',
+         typename KeyParse = Parse<K>, typename ValueParse = Parse<V> >
+class MapParse {
+public:
+    FlatMap<K, V> operator()(const std::string& s) const throw(std::exception) {
+        FlatMap<K, V> t;
+        (*this)(s, t);
+        return t;
+    }
+
+    /**
+     * @brief parse into an existing map, reuse its capacity
+     * @param [in] std::string s
+     * @param [out] FlatMap<K, V> t
+     * @return void
+     * @exception throw std::exception when the format is invalid or a key is duplicate
+    **/
+    void operator()(const std::string& s, FlatMap<K, V>& t) const throw(std::exception) {
+        ItemSplitter<MapParse, ItemSep, CountSep> items(s);
+        std::vector<typename FlatMap<K, V>::value_type>& v = t.items();
+        v.resize(items.num());
+        std::string& part = buffer();
+        for (size_t i = 0; i < v.size(); i++) {
+            const std::string& item = items.next();
+            std::string::size_type pos = item.find(KvSep);
+            if (pos == std::string::npos) {
+                throw std::invalid_argument("can not find key separator for map");
+            }
+            part.assign(item, 0, pos);
+            parse_to<KeyParse>(part, v[i].first);
+            part.assign(item, pos + 1, std::string::npos);
+            parse_to<ValueParse>(part, v[i].second);
+        }
+        items.finish();
+        if (t.sort_unique() != 0) {
+            throw std::invalid_argument("duplicate key for map");
+        }
+    }
+
+private:
+    //key or value of the current item, kept for later columns
+    static std::string& buffer() {
+        static thread_local std::string part;
+        return part;
+    }
+};
+
+/**
+ * specilize Parse for 'FlatMap<K, V>'
+ * the column is 'num:k1:v1,k2:v2', use MapParse for other separators
+ */
+template <typename K, typename V>
+class Parse<FlatMap<K, V>> : public MapParse<K, V> {
+};
+
+}
+#endif // GOODCODER_FLAT_MAP_H
@@ -0,0 +1,82 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test FlatMap and MapParse
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "flat_map.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::FlatMap;
+using baidu::MapParse;
+
+//test map of built-in types
+TEST(FlatMap, parse) {
+    Parser<FlatMap<int, float>> p0;
+    LineParser lp;
+    lp.add_parser(&p0);
+
+    EXPECT_EQ(lp.parse("3:7:0.5,2:1.5,5:2.5"), 0);
+    ASSERT_EQ(p0.data().size(), 3);
+    //items are sorted by key
+    EXPECT_EQ(p0.data().begin()->first, 2);
+    ASSERT_TRUE(p0.data().find(5) != NULL);
+    EXPECT_FLOAT_EQ(*p0.data().find(5), 2.5);
+    EXPECT_FLOAT_EQ(*p0.data().find(7), 0.5);
+    EXPECT_TRUE(p0.data().find(3) == NULL);
+    EXPECT_TRUE(p0.data().find(8) == NULL);
+
+    EXPECT_EQ(lp.parse("1:1:1"), 0);
+    EXPECT_EQ(p0.data().size(), 1);
+    EXPECT_TRUE(p0.data().find(2) == NULL);
+
+    //duplicate key, no key separator, wrong count, bad value
+    EXPECT_EQ(lp.parse("2:1:1,1:2"), -1);
+    EXPECT_EQ(lp.parse("1:1"), -1);
+    EXPECT_EQ(lp.parse("2:1:1"), -1);
+    EXPECT_EQ(lp.parse("1:1:1,2:2"), -1);
+    EXPECT_EQ(lp.parse("1:1:x"), -1);
+    EXPECT_EQ(lp.parse("x:1:1"), -1);
+}
+
+//test map of strings with other separators
+TEST(FlatMap, separators) {
+    Parser<FlatMap<std::string, std::vector<int>>,
+            MapParse<std::string, std::vector<int>, ';', '='> > p0;
+    LineParser lp;
+    lp.add_parser(&p0);
+
+    EXPECT_EQ(lp.parse("2:b=2:1,2;a=1:3"), 0);
+    ASSERT_EQ(p0.data().size(), 2);
+    EXPECT_STREQ(p0.data().begin()->first.c_str(), "a");
+    const std::vector<int>* b = p0.data().find("b");
+    ASSERT_TRUE(b != NULL);
+    ASSERT_EQ(b->size(), 2);
+    EXPECT_EQ((*b)[1], 2);
+
+    //values are parsed in place and keep their capacity
+    const int* data = b->data();
+    EXPECT_EQ(lp.parse("2:a=1:5;b=1:6"), 0);
+    b = p0.data().find("b");
+    ASSERT_TRUE(b != NULL);
+    EXPECT_EQ((*b)[0], 6);
+    EXPECT_EQ(b->data(), data);
+
+    EXPECT_EQ(lp.parse("0:"), -1);
+    EXPECT_EQ(lp.parse("1:a:1:5"), -1);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,476 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// huge page backed memory for loaded columns: page regions, an arena and an allocator
+
+#ifndef GOODCODER_HUGE_PAGE_H
+#define GOODCODER_HUGE_PAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+namespace baidu {
+
+//size of a transparent or hugetlbfs huge page on x86_64
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+//column starts are aligned to this for SIMD consumers
+const size_t CACHE_LINE_SIZE = 64;
+
+enum HugePageMode {
+    //normal pages
+    HUGE_PAGE_NONE = 0,
+    //transparent huge pages, madvise(MADV_HUGEPAGE) on a 2MB aligned region
+    HUGE_PAGE_TRANSPARENT = 1,
+    //pages of the hugetlbfs pool by MAP_HUGETLB, needs vm.nr_hugepages
+    HUGE_PAGE_EXPLICIT = 2,
+};
+
+/**
+ * HugePageStats counts the regions of this process mapped by map_region
+ * the bytes are of the regions mapped now, unmapped regions are subtracted
+ */
+struct HugePageStats {
+    //all mapped bytes
+    std::atomic<uint64_t> mapped_bytes;
+    //bytes from the hugetlbfs pool, they are huge pages for sure
+    std::atomic<uint64_t> explicit_bytes;
+    //bytes advised as transparent huge pages, see anon_huge_bytes for the real backing
+    std::atomic<uint64_t> transparent_bytes;
+    //number of regions mapped in a smaller mode than requested
+    std::atomic<uint64_t> fallbacks;
+
+    HugePageStats() : mapped_bytes(0), explicit_bytes(0), transparent_bytes(0), fallbacks(0) {};
+};
+
+/**
+ * @brief the stats of this process
+ * @return HugePageStats&
+**/
+inline HugePageStats& huge_page_stats() {
+    static HugePageStats stats;
+    return stats;
+}
+
+//anonymous memory mapped by map_region
+struct PageRegion {
+    void* addr;
+    size_t bytes;
+    //the mode really used, may be smaller than requested
+    HugePageMode mode;
+
+    PageRegion() : addr(NULL), bytes(0), mode(HUGE_PAGE_NONE) {};
+};
+
+inline size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+//map bytes aligned to HUGE_PAGE_SIZE, with madvise(MADV_HUGEPAGE)
+inline void* map_transparent(size_t bytes) {
+#ifdef MADV_HUGEPAGE
+    //map one more huge page, then cut the unaligned head and tail
+    size_t total = bytes + HUGE_PAGE_SIZE;
+    void* p = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(p);
+    uintptr_t aligned = round_up(begin, HUGE_PAGE_SIZE);
+    if (aligned > begin) {
+        munmap(p, aligned - begin);
+    }
+    size_t tail = begin + total - (aligned + bytes);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+    void* region = reinterpret_cast<void*>(aligned);
+    if (madvise(region, bytes, MADV_HUGEPAGE) != 0) {
+        munmap(region, bytes);
+        return NULL;
+    }
+    return region;
+#else
+    (void)bytes;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief map anonymous memory, a failed mode falls back to the next smaller one:
+ *        HUGE_PAGE_EXPLICIT -> HUGE_PAGE_TRANSPARENT -> HUGE_PAGE_NONE
+ *        huge modes map whole huge pages from a HUGE_PAGE_SIZE aligned address
+ * @param [in] size_t bytes
+ * @param [in] HugePageMode mode, the requested mode
+ * @param [out] PageRegion* region
+ * @return int
+ * @retval 0:succeed, -1:out of memory
+**/
+inline int map_region(size_t bytes, HugePageMode mode, PageRegion* region) {
+    if (bytes == 0) {
+        return -1;
+    }
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* p = NULL;
+    HugePageMode used = mode;
+    size_t mapped = round_up(bytes, mode == HUGE_PAGE_NONE ? page : HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+    if (used == HUGE_PAGE_EXPLICIT) {
+        p = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            p = NULL;
+        }
+    }
+#endif
+    if (p == NULL && used == HUGE_PAGE_EXPLICIT) {
+        used = HUGE_PAGE_TRANSPARENT;
+    }
+    if (p == NULL && used == HUGE_PAGE_TRANSPARENT) {
+        p = map_transparent(mapped);
+        if (p == NULL) {
+            used = HUGE_PAGE_NONE;
+        }
+    }
+    if (p == NULL) {
+        p = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            return -1;
+        }
+    }
+    region->addr = p;
+    region->bytes = mapped;
+    region->mode = used;
+
+    HugePageStats& stats = huge_page_stats();
+    stats.mapped_bytes += mapped;
+    if (used == HUGE_PAGE_EXPLICIT) {
+        stats.explicit_bytes += mapped;
+    } else if (used == HUGE_PAGE_TRANSPARENT) {
+        stats.transparent_bytes += mapped;
+    }
+    if (used != mode) {
+        stats.fallbacks++;
+    }
+    return 0;
+}
+
+/**
+ * @brief unmap a region mapped by map_region, and clear it
+ * @param [in/out] PageRegion* region
+ * @return void
+**/
+inline void unmap_region(PageRegion* region) {
+    if (region->addr == NULL) {
+        return;
+    }
+    munmap(region->addr, region->bytes);
+    HugePageStats& stats = huge_page_stats();
+    stats.mapped_bytes -= region->bytes;
+    if (region->mode == HUGE_PAGE_EXPLICIT) {
+        stats.explicit_bytes -= region->bytes;
+    } else if (region->mode == HUGE_PAGE_TRANSPARENT) {
+        stats.transparent_bytes -= region->bytes;
+    }
+    *region = PageRegion();
+}
+
+/**
+ * @brief bytes of the region backed by transparent huge pages now, read from /proc/self/smaps
+ *        the kernel may merge the region with a neighbour mapping, so this is an estimate
+ * @param [in] const PageRegion& region
+ * @return size_t
+**/
+inline size_t anon_huge_bytes(const PageRegion& region) {
+    if (region.addr == NULL) {
+        return 0;
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(region.addr);
+    uintptr_t end = begin + region.bytes;
+    std::ifstream fs("/proc/self/smaps");
+    std::string line;
+    size_t total = 0;
+    size_t overlap = 0;
+    while (std::getline(fs, line)) {
+        unsigned long long vma_begin = 0;
+        unsigned long long vma_end = 0;
+        unsigned long long kb = 0;
+        if (sscanf(line.c_str(), "%llx-%llx ", &vma_begin, &vma_end) == 2) {
+            uintptr_t b = std::max<uintptr_t>(begin, vma_begin);
+            uintptr_t e = std::min<uintptr_t>(end, vma_end);
+            overlap = (b < e) ? e - b : 0;
+        } else if (overlap > 0 && sscanf(line.c_str(), "AnonHugePages: %llu kB", &kb) == 1) {
+            total += std::min<size_t>(kb * 1024, overlap);
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief bytes of the region backed by huge pages
+ * @param [in] const PageRegion& region
+ * @return size_t
+**/
+inline size_t huge_backed_bytes(const PageRegion& region) {
+    if (region.mode == HUGE_PAGE_EXPLICIT) {
+        return region.bytes;
+    }
+    if (region.mode == HUGE_PAGE_TRANSPARENT) {
+        return anon_huge_bytes(region);
+    }
+    return 0;
+}
+
+/**
+ * HugePageArena allocates column buffers from big blocks of huge pages
+ * every allocation starts at an address aligned to its align, CACHE_LINE_SIZE at least;
+ * a request larger than half a block, or not fitting an aligned start in a new block,
+ * gets a block of its own
+ * memory is returned when the arena is destroyed or cleared
+ * it is not thread-safe, use one arena for each loader thread
+ */
+class HugePageArena {
+public:
+    /**
+     * @param [in] HugePageMode mode
+     * @param [in] size_t block_size, rounded up to HUGE_PAGE_SIZE
+    **/
+    explicit HugePageArena(HugePageMode mode, size_t block_size = 32 * HUGE_PAGE_SIZE) :
+            _mode(mode), _block_size(round_up(std::max<size_t>(block_size, 1), HUGE_PAGE_SIZE)),
+            _used(0), _allocated(0) {};
+
+    ~HugePageArena() {
+        clear();
+    }
+
+    /**
+     * @brief allocate bytes aligned to align
+     * @param [in] size_t bytes
+     * @param [in] size_t align, a power of 2 not larger than HUGE_PAGE_SIZE
+     * @return void*
+     * @retval NULL:out of memory or invalid align
+    **/
+    void* allocate(size_t bytes, size_t align = CACHE_LINE_SIZE) {
+        align = std::max(align, CACHE_LINE_SIZE);
+        if ((align & (align - 1)) != 0 || align > HUGE_PAGE_SIZE) {
+            return NULL;
+        }
+        bytes = std::max<size_t>(bytes, 1);
+        if (bytes <= _block_size / 2) {
+            size_t offset = aligned_offset(_block, _used, align);
+            if (_block.addr == NULL || offset + bytes > _block.bytes) {
+                PageRegion region;
+                if (map_region(_block_size, _mode, &region) != 0) {
+                    return NULL;
+                }
+                if (_block.addr != NULL) {
+                    _regions.push_back(_block);
+                }
+                _block = region;
+                _used = 0;
+                offset = aligned_offset(_block, 0, align);
+            }
+            //a block of normal pages may start too far from an align boundary
+            if (offset + bytes <= _block.bytes) {
+                _used = offset + bytes;
+                _allocated += bytes;
+                return static_cast<char*>(_block.addr) + offset;
+            }
+        }
+        //a block of its own, the current block goes on serving small requests
+        PageRegion region;
+        if (map_region(bytes, _mode, &region) != 0) {
+            return NULL;
+        }
+        if (aligned_offset(region, 0, align) != 0) {
+            //normal pages, map align bytes more to cut an aligned start from
+            unmap_region(&region);
+            if (map_region(bytes + align, _mode, &region) != 0) {
+                return NULL;
+            }
+        }
+        _regions.push_back(region);
+        _allocated += bytes;
+        return static_cast<char*>(region.addr) + aligned_offset(region, 0, align);
+    }
+
+    /**
+     * @brief allocate an uninitialized array
+     * @param [in] size_t n, number of elements
+     * @return T*
+     * @retval NULL:out of memory
+    **/
+    template <typename T>
+    T* allocate_array(size_t n) {
+        static_assert(std::is_trivial<T>::value, "HugePageArena only holds trivial types");
+        if (n > (~static_cast<size_t>(0)) / sizeof(T)) {
+            return NULL;
+        }
+        return static_cast<T*>(allocate(n * sizeof(T), std::max(alignof(T), CACHE_LINE_SIZE)));
+    }
+
+    //return all memory
+    void clear() {
+        for (size_t i = 0; i < _regions.size(); i++) {
+            unmap_region(&_regions[i]);
+        }
+        _regions.clear();
+        unmap_region(&_block);
+        _used = 0;
+        _allocated = 0;
+    }
+
+    //bytes requested by allocate
+    size_t allocated_bytes() const {
+        return _allocated;
+    }
+
+    //bytes of all blocks
+    size_t mapped_bytes() const {
+        size_t total = _block.bytes;
+        for (size_t i = 0; i < _regions.size(); i++) {
+            total += _regions[i].bytes;
+        }
+        return total;
+    }
+
+    //bytes of all blocks backed by huge pages now, reads /proc/self/smaps
+    size_t huge_backed_bytes() const {
+        size_t total = baidu::huge_backed_bytes(_block);
+        for (size_t i = 0; i < _regions.size(); i++) {
+            total += baidu::huge_backed_bytes(_regions[i]);
+        }
+        return total;
+    }
+
+private:
+    //offset of the first address at or after region.addr + used aligned to align
+    static size_t aligned_offset(const PageRegion& region, size_t used, size_t align) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(region.addr);
+        return round_up(base + used, align) - base;
+    }
+
+    HugePageMode _mode;
+    size_t _block_size;
+    //full blocks and blocks of large requests
+    std::vector<PageRegion> _regions;
+    //the current block, _used bytes of it are allocated
+    PageRegion _block;
+    size_t _used;
+    size_t _allocated;
+    DISALLOW_COPY_AND_ASSIGN(HugePageArena);
+};
+
+/**
+ * AllocatorRegions keeps the regions mapped by every HugePageAllocator, by address
+ * they are kept out of the buffers, so a buffer of whole huge pages maps only its own pages;
+ * only buffers of HUGE_PAGE_SIZE or more are here, so the lock is taken next to an mmap
+ */
+struct AllocatorRegions {
+    std::mutex mutex;
+    std::unordered_map<void*, PageRegion> regions;
+};
+
+inline AllocatorRegions& allocator_regions() {
+    static AllocatorRegions regions;
+    return regions;
+}
+
+/**
+ * HugePageAllocator is a std allocator for column vectors,
+ * such as std::vector<float, HugePageAllocator<float> >
+ * buffers of HUGE_PAGE_SIZE or more are mapped by map_region, and start at a huge page
+ * in the huge modes; smaller ones are allocated by posix_memalign;
+ * all start at a CACHE_LINE_SIZE boundary
+ */
+template <typename T>
+class HugePageAllocator {
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef HugePageAllocator<U> other;
+    };
+
+    explicit HugePageAllocator(HugePageMode mode = HUGE_PAGE_TRANSPARENT) : _mode(mode) {};
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>& other) : _mode(other.mode()) {};
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+        if (n > (~static_cast<size_t>(0)) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        if (bytes < HUGE_PAGE_SIZE) {
+            void* p = NULL;
+            if (posix_memalign(&p, std::max(alignof(T), CACHE_LINE_SIZE), bytes) != 0) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(p);
+        }
+        PageRegion region;
+        if (map_region(bytes, _mode, &region) != 0) {
+            throw std::bad_alloc();
+        }
+        AllocatorRegions& regions = allocator_regions();
+        std::lock_guard<std::mutex> lock(regions.mutex);
+        regions.regions[region.addr] = region;
+        return static_cast<T*>(region.addr);
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n * sizeof(T) < HUGE_PAGE_SIZE) {
+            free(p);
+            return;
+        }
+        PageRegion region;
+        {
+            AllocatorRegions& regions = allocator_regions();
+            std::lock_guard<std::mutex> lock(regions.mutex);
+            std::unordered_map<void*, PageRegion>::iterator it = regions.regions.find(p);
+            if (it == regions.regions.end()) {
+                return;
+            }
+            region = it->second;
+            regions.regions.erase(it);
+        }
+        unmap_region(&region);
+    }
+
+    HugePageMode mode() const {
+        return _mode;
+    }
+
+private:
+    HugePageMode _mode;
+};
+
+template <typename T, typename U>
+inline bool operator==(const HugePageAllocator<T>& a, const HugePageAllocator<U>& b) {
+    return a.mode() == b.mode();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const HugePageAllocator<T>& a, const HugePageAllocator<U>& b) {
+    return !(a == b);
+}
+
+}
+#endif // GOODCODER_HUGE_PAGE_H
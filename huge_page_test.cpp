@@ -0,0 +1,227 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test page regions, HugePageArena and HugePageAllocator
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "aggregator.h"
+#include "huge_page.h"
+#include "numa_table.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::ColumnCollector;
+using baidu::PageRegion;
+using baidu::HugePageArena;
+using baidu::HugePageAllocator;
+using baidu::HugePageStats;
+using baidu::NumaTopology;
+using baidu::NumaColumn;
+using baidu::map_region;
+using baidu::unmap_region;
+using baidu::huge_page_stats;
+using baidu::huge_backed_bytes;
+using baidu::HUGE_PAGE_NONE;
+using baidu::HUGE_PAGE_TRANSPARENT;
+using baidu::HUGE_PAGE_EXPLICIT;
+using baidu::HUGE_PAGE_SIZE;
+using baidu::CACHE_LINE_SIZE;
+using baidu::NUMA_INTERLEAVE;
+
+//test regions of every mode and the stats
+TEST(HugePage, map_region) {
+    HugePageStats& stats = huge_page_stats();
+    uint64_t mapped = stats.mapped_bytes;
+
+    PageRegion normal;
+    ASSERT_EQ(map_region(10000, HUGE_PAGE_NONE, &normal), 0);
+    EXPECT_EQ(normal.mode, HUGE_PAGE_NONE);
+    EXPECT_GE(normal.bytes, 10000);
+    EXPECT_LT(normal.bytes, HUGE_PAGE_SIZE);
+    EXPECT_EQ(stats.mapped_bytes, mapped + normal.bytes);
+    EXPECT_EQ(huge_backed_bytes(normal), 0);
+
+    //huge modes map whole aligned huge pages, or fall back
+    uint64_t fallbacks = stats.fallbacks;
+    PageRegion transparent;
+    ASSERT_EQ(map_region(HUGE_PAGE_SIZE + 1, HUGE_PAGE_TRANSPARENT, &transparent), 0);
+    EXPECT_EQ(transparent.bytes, 2 * HUGE_PAGE_SIZE);
+    if (transparent.mode == HUGE_PAGE_TRANSPARENT) {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(transparent.addr) % HUGE_PAGE_SIZE, 0);
+        EXPECT_GE(stats.transparent_bytes, transparent.bytes);
+        memset(transparent.addr, 1, transparent.bytes);
+        EXPECT_LE(huge_backed_bytes(transparent), transparent.bytes);
+    } else {
+        EXPECT_EQ(stats.fallbacks, fallbacks + 1);
+    }
+
+    PageRegion hugetlb;
+    ASSERT_EQ(map_region(100, HUGE_PAGE_EXPLICIT, &hugetlb), 0);
+    EXPECT_EQ(hugetlb.bytes, HUGE_PAGE_SIZE);
+    memset(hugetlb.addr, 1, hugetlb.bytes);
+    if (hugetlb.mode == HUGE_PAGE_EXPLICIT) {
+        EXPECT_EQ(huge_backed_bytes(hugetlb), HUGE_PAGE_SIZE);
+        EXPECT_GE(stats.explicit_bytes, HUGE_PAGE_SIZE);
+    } else {
+        EXPECT_GT(stats.fallbacks, fallbacks);
+    }
+
+    EXPECT_EQ(stats.mapped_bytes, mapped + normal.bytes + transparent.bytes + hugetlb.bytes);
+    unmap_region(&normal);
+    unmap_region(&transparent);
+    unmap_region(&hugetlb);
+    EXPECT_TRUE(normal.addr == NULL);
+    EXPECT_EQ(stats.mapped_bytes, mapped);
+
+    EXPECT_EQ(map_region(0, HUGE_PAGE_NONE, &normal), -1);
+}
+
+//test arena allocations are aligned and do not overlap
+TEST(HugePage, arena) {
+    uint64_t mapped = huge_page_stats().mapped_bytes;
+    {
+        HugePageArena arena(HUGE_PAGE_TRANSPARENT, HUGE_PAGE_SIZE);
+        //a large request first, small ones must not use its block
+        char* big = static_cast<char*>(arena.allocate(HUGE_PAGE_SIZE));
+        ASSERT_TRUE(big != NULL);
+        memset(big, 'b', HUGE_PAGE_SIZE);
+
+        std::vector<char*> small;
+        for (int i = 0; i < 1000; i++) {
+            char* p = static_cast<char*>(arena.allocate(i % 100 + 1));
+            ASSERT_TRUE(p != NULL);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % CACHE_LINE_SIZE, 0);
+            memset(p, i % 128, i % 100 + 1);
+            small.push_back(p);
+        }
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_EQ(small[i][i % 100], i % 128);
+        }
+        for (size_t i = 0; i < HUGE_PAGE_SIZE; i += 4096) {
+            ASSERT_EQ(big[i], 'b');
+        }
+
+        float* column = arena.allocate_array<float>(1000);
+        ASSERT_TRUE(column != NULL);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(column) % CACHE_LINE_SIZE, 0);
+        void* page = arena.allocate(10, 4096);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(page) % 4096, 0);
+        EXPECT_TRUE(arena.allocate(10, 100) == NULL);
+
+        EXPECT_GT(arena.allocated_bytes(), HUGE_PAGE_SIZE);
+        EXPECT_GE(arena.mapped_bytes(), 2 * HUGE_PAGE_SIZE);
+        EXPECT_LE(arena.huge_backed_bytes(), arena.mapped_bytes());
+        EXPECT_EQ(huge_page_stats().mapped_bytes, mapped + arena.mapped_bytes());
+
+        arena.clear();
+        EXPECT_EQ(arena.mapped_bytes(), 0);
+        EXPECT_TRUE(arena.allocate(1) != NULL);
+    }
+    EXPECT_EQ(huge_page_stats().mapped_bytes, mapped);
+}
+
+//test align is of the address, in blocks of normal pages and in blocks of their own
+TEST(HugePage, arena_align) {
+    uint64_t mapped = huge_page_stats().mapped_bytes;
+    {
+        HugePageArena arena(HUGE_PAGE_NONE, HUGE_PAGE_SIZE);
+        for (size_t align = CACHE_LINE_SIZE; align <= HUGE_PAGE_SIZE; align *= 2) {
+            char* small = static_cast<char*>(arena.allocate(10, align));
+            ASSERT_TRUE(small != NULL);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(small) % align, 0);
+            memset(small, 1, 10);
+            //half a block, an aligned start may not fit in a new block
+            char* half = static_cast<char*>(arena.allocate(HUGE_PAGE_SIZE / 2, align));
+            ASSERT_TRUE(half != NULL);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(half) % align, 0);
+            memset(half, 2, HUGE_PAGE_SIZE / 2);
+            char* large = static_cast<char*>(arena.allocate(HUGE_PAGE_SIZE + 1, align));
+            ASSERT_TRUE(large != NULL);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % align, 0);
+            memset(large, 3, HUGE_PAGE_SIZE + 1);
+        }
+    }
+    EXPECT_EQ(huge_page_stats().mapped_bytes, mapped);
+}
+
+//test column vectors with HugePageAllocator
+TEST(HugePage, allocator) {
+    uint64_t mapped = huge_page_stats().mapped_bytes;
+    {
+        std::vector<int, HugePageAllocator<int> > v((HugePageAllocator<int>(HUGE_PAGE_EXPLICIT)));
+        for (int i = 0; i < 1000000; i++) {
+            v.push_back(i);
+            if (i == 10) {
+                EXPECT_EQ(reinterpret_cast<uintptr_t>(v.data()) % CACHE_LINE_SIZE, 0);
+            }
+        }
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(v.data()) % CACHE_LINE_SIZE, 0);
+        EXPECT_GT(huge_page_stats().mapped_bytes, mapped);
+        for (int i = 0; i < 1000000; i += 997) {
+            ASSERT_EQ(v[i], i);
+        }
+
+        //the collector of a loader
+        Parser<int> p0;
+        LineParser lp;
+        lp.add_parser(&p0);
+        ColumnCollector<Parser<int>, HugePageAllocator<int> > ids(&p0);
+        for (int i = 0; i < 1000; i++) {
+            ASSERT_EQ(lp.parse(std::to_string(i)), 0);
+            ids.visit();
+        }
+        ASSERT_EQ(ids.result().size(), 1000);
+        EXPECT_EQ(ids.result()[999], 999);
+        EXPECT_EQ(ids.result().get_allocator().mode(), HUGE_PAGE_TRANSPARENT);
+    }
+    EXPECT_EQ(huge_page_stats().mapped_bytes, mapped);
+
+    //a buffer of whole huge pages maps exactly its pages, from a huge page boundary
+    HugePageAllocator<char> alloc(HUGE_PAGE_TRANSPARENT);
+    for (size_t pages = 1; pages <= 2; pages++) {
+        uint64_t fallbacks = huge_page_stats().fallbacks;
+        char* p = alloc.allocate(pages * HUGE_PAGE_SIZE);
+        EXPECT_EQ(huge_page_stats().mapped_bytes, mapped + pages * HUGE_PAGE_SIZE);
+        if (huge_page_stats().fallbacks == fallbacks) {
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % HUGE_PAGE_SIZE, 0);
+        }
+        memset(p, 1, pages * HUGE_PAGE_SIZE);
+        alloc.deallocate(p, pages * HUGE_PAGE_SIZE);
+        EXPECT_EQ(huge_page_stats().mapped_bytes, mapped);
+    }
+}
+
+//test NumaColumn on huge pages
+TEST(HugePage, numa_column) {
+    NumaTopology topo = NumaTopology::simulate(2);
+    std::vector<double> src(1000000);
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = i * 0.5;
+    }
+    NumaColumn<double> col(topo, NUMA_INTERLEAVE, HUGE_PAGE_TRANSPARENT);
+    ASSERT_EQ(col.load(src.data(), src.size()), 0);
+    ASSERT_EQ(col.regions().size(), 1);
+    EXPECT_EQ(col.regions()[0].bytes % HUGE_PAGE_SIZE, 0);
+    const double* local = col.local();
+    for (size_t i = 0; i < src.size(); i += 1001) {
+        ASSERT_DOUBLE_EQ(local[i], i * 0.5);
+    }
+    EXPECT_EQ(local[src.size() - 1], (src.size() - 1) * 0.5);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
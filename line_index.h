@@ -0,0 +1,488 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// LineIndex is a sampled line-offset index kept in a sidecar file,
+// it gives random access to the lines of a dict
+// MappedDict parses arbitrary line ranges of a mmap-ed dict
+
+#ifndef GOODCODER_LINE_INDEX_H
+#define GOODCODER_LINE_INDEX_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <com_log.h>
+
+#include "parser.h"
+
+namespace baidu {
+
+/**
+ * LineIndex keeps the offset of every sample_every-th line
+ * offsets are delta-encoded as varints, with an absolute checkpoint every
+ * CHECKPOINT_EVERY samples, so an index of 1B lines sampled every 1024 lines
+ * takes a few MB and a lookup decodes at most CHECKPOINT_EVERY varints
+ */
+class LineIndex {
+public:
+    static const size_t CHECKPOINT_EVERY = 64;
+
+    LineIndex() : _sample_every(0), _lines(0), _file_size(0), _mtime(0), _mtime_nsec(0),
+            _inode(0), _samples(0), _last_sample(0) {};
+
+    /**
+     * @brief the sidecar file of a dict
+     * @param [in] std::string path, path of the dict
+     * @return std::string
+    **/
+    static std::string index_path(const std::string& path) {
+        return path + ".idx";
+    }
+
+    /**
+     * @brief scan a dict for '\n' and sample the line offsets
+     *        memchr is vectorized by glibc, so the scan runs at memory speed
+     * @param [in] std::string path, path of the dict
+     * @param [in] size_t sample_every, keep the offset of every sample_every-th line
+     * @return int
+     * @retval 0:succeed, -1:the dict can not be read or its encoded offsets exceed 4GB
+    **/
+    int build(const std::string& path, size_t sample_every) {
+        clear();
+        if (sample_every == 0) {
+            return -1;
+        }
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0) {
+            return -1;
+        }
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return -1;
+        }
+        _sample_every = sample_every;
+        std::vector<char> buf(1 << 20);
+        uint64_t base = 0;
+        //offset of the next line start
+        uint64_t line_start = 0;
+        bool at_line_start = true;
+        ssize_t n = 0;
+        while ((n = read(fd, &buf[0], buf.size())) > 0) {
+            const char* begin = &buf[0];
+            const char* end = begin + n;
+            const char* p = begin;
+            while (p < end) {
+                if (at_line_start) {
+                    if (add_line(line_start) != 0) {
+                        close(fd);
+                        clear();
+                        return -1;
+                    }
+                    at_line_start = false;
+                }
+                const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+                if (nl == NULL) {
+                    break;
+                }
+                p = nl + 1;
+                line_start = base + (p - begin);
+                at_line_start = true;
+            }
+            base += n;
+        }
+        close(fd);
+        if (n < 0) {
+            clear();
+            return -1;
+        }
+        _file_size = base;
+        _mtime = static_cast<uint64_t>(st.st_mtim.tv_sec);
+        _mtime_nsec = static_cast<uint64_t>(st.st_mtim.tv_nsec);
+        _inode = static_cast<uint64_t>(st.st_ino);
+        return 0;
+    }
+
+    /**
+     * @brief write the index to the sidecar file of a dict
+     *        it is written to a temp file renamed to the sidecar, so a reader
+     *        never sees a partly written index
+     * @param [in] std::string path, path of the dict
+     * @return int
+     * @retval 0:succeed, -1:write error
+    **/
+    int save(const std::string& path) const {
+        std::string tmp = index_path(path) + ".tmp." + std::to_string(getpid());
+        std::ofstream fs(tmp.c_str(), std::ios::binary | std::ios::trunc);
+        uint64_t header[HEADER_SIZE] = {MAGIC, _sample_every, _lines, _file_size, _mtime,
+            _mtime_nsec, _inode, _deltas.size()};
+        fs.write(reinterpret_cast<const char*>(header), sizeof(header));
+        fs.write(_deltas.data(), _deltas.size());
+        fs.close();
+        if (!fs.good() || rename(tmp.c_str(), index_path(path).c_str()) != 0) {
+            remove(tmp.c_str());
+            return -1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief read the index from the sidecar file of a dict
+     *        the index is stale when the size, the mtime in ns or the inode of the dict changed,
+     *        so a dict replaced by a file of the same size in the same second is found
+     * @param [in] std::string path, path of the dict
+     * @return int
+     * @retval 0:succeed, -1:no index, broken or stale index
+    **/
+    int load(const std::string& path) {
+        clear();
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            return -1;
+        }
+        uint64_t file_size = static_cast<uint64_t>(st.st_size);
+        std::ifstream fs(index_path(path).c_str(), std::ios::binary);
+        uint64_t header[HEADER_SIZE];
+        if (!fs.read(reinterpret_cast<char*>(header), sizeof(header))
+                || header[0] != MAGIC || header[1] == 0 || header[3] != file_size
+                || header[4] != static_cast<uint64_t>(st.st_mtim.tv_sec)
+                || header[5] != static_cast<uint64_t>(st.st_mtim.tv_nsec)
+                || header[6] != static_cast<uint64_t>(st.st_ino)
+                || header[7] > (std::numeric_limits<uint32_t>::max)()) {
+            return -1;
+        }
+        std::string deltas(header[7], '\0');
+        if (!deltas.empty() && !fs.read(&deltas[0], deltas.size())) {
+            return -1;
+        }
+        _sample_every = header[1];
+        //rebuild the checkpoints, and check the deltas match the header
+        const char* p = deltas.data();
+        const char* end = p + deltas.size();
+        uint64_t offset = 0;
+        size_t samples = 0;
+        while (p < end) {
+            uint64_t delta = 0;
+            if (decode(&p, end, &delta) != 0 || offset + delta > file_size) {
+                clear();
+                return -1;
+            }
+            offset += delta;
+            if (samples % CHECKPOINT_EVERY == 0) {
+                _checkpoints.push_back(offset);
+                _checkpoint_pos.push_back(static_cast<uint32_t>(p - deltas.data()));
+            }
+            samples++;
+        }
+        if (samples != (header[2] + _sample_every - 1) / _sample_every) {
+            clear();
+            return -1;
+        }
+        _deltas.swap(deltas);
+        _samples = samples;
+        _last_sample = offset;
+        _lines = header[2];
+        _file_size = file_size;
+        _mtime = header[4];
+        _mtime_nsec = header[5];
+        _inode = header[6];
+        return 0;
+    }
+
+    /**
+     * @brief load the sidecar index of a dict, build and save it when missing or stale
+     * @param [in] std::string path, path of the dict
+     * @param [in] size_t sample_every, used when the index is built
+     * @return int
+     * @retval 0:succeed, -1:the dict can not be read or indexed
+    **/
+    int load_or_build(const std::string& path, size_t sample_every) {
+        if (load(path) == 0) {
+            return 0;
+        }
+        if (build(path, sample_every) != 0) {
+            return -1;
+        }
+        if (save(path) != 0) {
+            CWARNING_LOG("save line index failed:%s", index_path(path).c_str());
+        }
+        return 0;
+    }
+
+    /**
+     * @brief find the nearest sampled line not after line n
+     * @param [in] size_t n, line number from 0
+     * @param [out] size_t* sample_line, the sampled line
+     * @param [out] uint64_t* offset, file offset of sample_line
+     * @return int
+     * @retval 0:succeed, -1:n is out of range
+    **/
+    int locate(size_t n, size_t* sample_line, uint64_t* offset) const {
+        if (n >= _lines) {
+            return -1;
+        }
+        size_t sample = n / _sample_every;
+        size_t block = sample / CHECKPOINT_EVERY;
+        uint64_t pos = _checkpoints[block];
+        const char* p = _deltas.data() + _checkpoint_pos[block];
+        const char* end = _deltas.data() + _deltas.size();
+        for (size_t i = block * CHECKPOINT_EVERY; i < sample; i++) {
+            uint64_t delta = 0;
+            decode(&p, end, &delta);
+            pos += delta;
+        }
+        *sample_line = sample * _sample_every;
+        *offset = pos;
+        return 0;
+    }
+
+    size_t lines() const {
+        return _lines;
+    }
+
+    size_t sample_every() const {
+        return _sample_every;
+    }
+
+    uint64_t file_size() const {
+        return _file_size;
+    }
+
+    //bytes used by the encoded offsets
+    size_t encoded_size() const {
+        return _deltas.size();
+    }
+
+private:
+    //"LNEINDX2", the header of version 1 had no mtime_nsec and inode
+    static const uint64_t MAGIC = 0x3258444e49454e4cULL;
+    static const size_t HEADER_SIZE = 8;
+
+    void clear() {
+        _sample_every = 0;
+        _lines = 0;
+        _file_size = 0;
+        _mtime = 0;
+        _mtime_nsec = 0;
+        _inode = 0;
+        _samples = 0;
+        _last_sample = 0;
+        _deltas.clear();
+        _checkpoints.clear();
+        _checkpoint_pos.clear();
+    }
+
+    //-1 when the deltas outgrow the uint32_t checkpoint positions
+    int add_line(uint64_t offset) {
+        if (_lines % _sample_every == 0) {
+            size_t pos = _deltas.size() + varint_size(offset - _last_sample);
+            if (pos > (std::numeric_limits<uint32_t>::max)()) {
+                return -1;
+            }
+            if (_samples % CHECKPOINT_EVERY == 0) {
+                _checkpoints.push_back(offset);
+                _checkpoint_pos.push_back(static_cast<uint32_t>(pos));
+            }
+            encode(offset - _last_sample);
+            _last_sample = offset;
+            _samples++;
+        }
+        _lines++;
+        return 0;
+    }
+
+    static size_t varint_size(uint64_t v) {
+        size_t n = 1;
+        while (v >= 0x80) {
+            v >>= 7;
+            n++;
+        }
+        return n;
+    }
+
+    void encode(uint64_t v) {
+        while (v >= 0x80) {
+            _deltas.push_back(static_cast<char>((v & 0x7f) | 0x80));
+            v >>= 7;
+        }
+        _deltas.push_back(static_cast<char>(v));
+    }
+
+    static int decode(const char** p, const char* end, uint64_t* v) {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+            uint8_t c = static_cast<uint8_t>(**p);
+            (*p)++;
+            result |= static_cast<uint64_t>(c & 0x7f) << shift;
+            if ((c & 0x80) == 0) {
+                *v = result;
+                return 0;
+            }
+        }
+        return -1;
+    }
+
+    size_t _sample_every;
+    size_t _lines;
+    uint64_t _file_size;
+    //identity of the indexed dict: mtime in seconds and ns, and inode
+    uint64_t _mtime;
+    uint64_t _mtime_nsec;
+    uint64_t _inode;
+    size_t _samples;
+    uint64_t _last_sample;
+    //varint deltas between sampled offsets
+    std::string _deltas;
+    //absolute offset of every CHECKPOINT_EVERY-th sample, and its end in _deltas
+    std::vector<uint64_t> _checkpoints;
+    std::vector<uint32_t> _checkpoint_pos;
+};
+
+template <typename Format>
+int BasicDictParser<Format>::seek_to_line(const LineIndex& index, size_t n) {
+    size_t line = 0;
+    uint64_t offset = 0;
+    if (Format::eol != '\n' || index.locate(n, &line, &offset) != 0) {
+        return -1;
+    }
+    _fs.clear();
+    _fs.seekg(offset);
+    for (; line < n && _fs.good(); line++) {
+        _fs.ignore((std::numeric_limits<std::streamsize>::max)(), '\n');
+    }
+    return _fs.good() ? 0 : -1;
+}
+
+/**
+ * MappedDict parses arbitrary line ranges of a dict through mmap
+ * the pages of a range are prefetched by madvise before parsing
+ * it is read-only, several threads may call parse_lines with their own columns
+ * by using one MappedDict for each LineParser
+ */
+class MappedDict {
+public:
+    explicit MappedDict(const std::string& path) : _data(NULL), _size(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                _data = static_cast<const char*>(p);
+                _size = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedDict() {
+        if (_data != NULL) {
+            munmap(const_cast<char*>(_data), _size);
+        }
+    }
+
+    //false when the file can not be mapped or is empty
+    bool is_open() const {
+        return _data != NULL;
+    }
+
+    int add_column(ParserBase* p) {
+        return _lp.add_parser(p);
+    }
+
+    /**
+     * @brief parse lines [first, first + count), skip invalid lines
+     * @param [in] const LineIndex& index, index of this dict
+     * @param [in] size_t first, line number from 0
+     * @param [in] size_t count, stops at the end of the dict
+     * @param [in] RowVisitor* visitor, called after every valid line
+     * @return size_t
+     * @retval number of valid lines
+    **/
+    size_t parse_lines(const LineIndex& index, size_t first, size_t count,
+            RowVisitor* visitor) {
+        size_t line = 0;
+        uint64_t offset = 0;
+        if (_data == NULL || index.file_size() != _size
+                || index.locate(first, &line, &offset) != 0) {
+            return 0;
+        }
+        const char* p = _data + offset;
+        const char* end = _data + _size;
+        for (; line < first && p < end; line++) {
+            p = next_line(p, end);
+        }
+        size_t left = end - p;
+        size_t average = average_line(index);
+        prefetch(p, (average == 0 || count > left / average) ? left : count * average);
+        size_t good = 0;
+        for (size_t i = 0; i < count && p < end; i++) {
+            const char* next = next_line(p, end);
+            size_t len = next - p;
+            if (len > 0 && p[len - 1] == '\n') {
+                len--;
+            }
+            if (len > parse_limits().max_line_length) {
+                report_error(PARSE_ERROR_LINE, "line format error");
+            } else if (_lp.parse(_line.assign(p, len)) == 0) {
+                visitor->visit();
+                good++;
+            } else {
+                report_error(PARSE_ERROR_LINE, "line format error");
+            }
+            p = next;
+        }
+        return good;
+    }
+
+    /**
+     * @brief parse line n
+     * @return int
+     * @retval 0:succeed, -1:line n is invalid or out of range
+    **/
+    int parse_line(const LineIndex& index, size_t n, RowVisitor* visitor) {
+        return parse_lines(index, n, 1, visitor) == 1 ? 0 : -1;
+    }
+
+private:
+    static const char* next_line(const char* p, const char* end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        return nl == NULL ? end : nl + 1;
+    }
+
+    static size_t average_line(const LineIndex& index) {
+        return index.lines() == 0 ? 0 : index.file_size() / index.lines() + 1;
+    }
+
+    void prefetch(const char* p, size_t len) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t begin = reinterpret_cast<uintptr_t>(p) & ~(page - 1);
+        uintptr_t last = reinterpret_cast<uintptr_t>(p) + len;
+        if (len > 0) {
+            madvise(reinterpret_cast<void*>(begin), last - begin, MADV_WILLNEED);
+        }
+    }
+
+    const char* _data;
+    size_t _size;
+    LineParser _lp;
+    //buffer of the current line, reused by every line
+    std::string _line;
+    DISALLOW_COPY_AND_ASSIGN(MappedDict);
+};
+
+}
+#endif // GOODCODER_LINE_INDEX_H
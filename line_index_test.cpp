@@ -0,0 +1,256 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test LineIndex, DictParser::seek_to_line and MappedDict
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "aggregator.h"
+#include "line_index.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::DictParser;
+using baidu::LineIndex;
+using baidu::MappedDict;
+using baidu::ColumnCollector;
+
+//write lines "i\txx..x" of different length, return the offset of every line
+static std::vector<uint64_t> write_dict(const char* path, int lines, bool last_newline) {
+    std::vector<uint64_t> offsets;
+    std::ofstream out(path, std::ios::binary);
+    uint64_t offset = 0;
+    for (int i = 0; i < lines; i++) {
+        offsets.push_back(offset);
+        std::string line = std::to_string(i) + "\t" + std::string(i % 37 + 1, 'x');
+        out << line;
+        offset += line.size();
+        if (i + 1 < lines || last_newline) {
+            out << "\n";
+            offset++;
+        }
+    }
+    return offsets;
+}
+
+//test build and locate every line
+TEST(LineIndex, build) {
+    const char* path = "line_index.txt";
+    std::vector<uint64_t> offsets = write_dict(path, 10000, false);
+    LineIndex index;
+    ASSERT_EQ(index.build(path, 16), 0);
+    EXPECT_EQ(index.lines(), 10000);
+    EXPECT_EQ(index.sample_every(), 16);
+    for (size_t n = 0; n < offsets.size(); n++) {
+        size_t line = 0;
+        uint64_t offset = 0;
+        ASSERT_EQ(index.locate(n, &line, &offset), 0);
+        ASSERT_EQ(line, n / 16 * 16);
+        ASSERT_EQ(offset, offsets[line]);
+    }
+    size_t line = 0;
+    uint64_t offset = 0;
+    EXPECT_EQ(index.locate(10000, &line, &offset), -1);
+
+    //a trailing '\n' does not start a new line
+    write_dict(path, 10000, true);
+    ASSERT_EQ(index.build(path, 1024), 0);
+    EXPECT_EQ(index.lines(), 10000);
+    EXPECT_LT(index.encoded_size(), 40);
+
+    EXPECT_EQ(index.build("no.txt", 16), -1);
+    EXPECT_EQ(index.build(path, 0), -1);
+    remove(path);
+}
+
+//test empty dict
+TEST(LineIndex, empty) {
+    const char* path = "line_index_empty.txt";
+    std::ofstream out(path);
+    out.close();
+    LineIndex index;
+    ASSERT_EQ(index.build(path, 4), 0);
+    EXPECT_EQ(index.lines(), 0);
+    size_t line = 0;
+    uint64_t offset = 0;
+    EXPECT_EQ(index.locate(0, &line, &offset), -1);
+    MappedDict md(path);
+    EXPECT_FALSE(md.is_open());
+    remove(path);
+}
+
+//test save, load and stale sidecar file
+TEST(LineIndex, sidecar) {
+    const char* path = "line_index_sidecar.txt";
+    std::vector<uint64_t> offsets = write_dict(path, 5000, true);
+    LineIndex built;
+    ASSERT_EQ(built.build(path, 8), 0);
+    ASSERT_EQ(built.save(path), 0);
+
+    LineIndex loaded;
+    ASSERT_EQ(loaded.load(path), 0);
+    EXPECT_EQ(loaded.lines(), built.lines());
+    EXPECT_EQ(loaded.encoded_size(), built.encoded_size());
+    for (size_t n = 0; n < offsets.size(); n += 7) {
+        size_t line = 0;
+        uint64_t offset = 0;
+        ASSERT_EQ(loaded.locate(n, &line, &offset), 0);
+        ASSERT_EQ(offset, offsets[line]);
+    }
+
+    //the dict grows, the index is stale
+    std::ofstream out(path, std::ios::app);
+    out << "5000\tappended\n";
+    out.close();
+    EXPECT_EQ(loaded.load(path), -1);
+    ASSERT_EQ(loaded.load_or_build(path, 8), 0);
+    EXPECT_EQ(loaded.lines(), 5001);
+    LineIndex again;
+    EXPECT_EQ(again.load(path), 0);
+    EXPECT_EQ(again.lines(), 5001);
+
+    //the dict is rewritten in place with the same size in the same second
+    struct stat st;
+    ASSERT_EQ(stat(path, &st), 0);
+    std::string content;
+    {
+        std::ifstream in(path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    content[0] = (content[0] == '1') ? '2' : '1';
+    {
+        std::ofstream rewrite(path, std::ios::binary | std::ios::trunc);
+        rewrite << content;
+    }
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    times[1].tv_nsec = (st.st_mtim.tv_nsec + 1) % 1000000000;
+    ASSERT_EQ(utimensat(AT_FDCWD, path, times, 0), 0);
+    EXPECT_EQ(again.load(path), -1);
+    ASSERT_EQ(again.load_or_build(path, 8), 0);
+
+    //the dict is replaced by another file of the same size and mtime
+    ASSERT_EQ(stat(path, &st), 0);
+    std::string replaced = std::string(path) + ".new";
+    {
+        std::ofstream rewrite(replaced.c_str(), std::ios::binary | std::ios::trunc);
+        rewrite << content;
+    }
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+    ASSERT_EQ(utimensat(AT_FDCWD, replaced.c_str(), times, 0), 0);
+    ASSERT_EQ(rename(replaced.c_str(), path), 0);
+    EXPECT_EQ(again.load(path), -1);
+    ASSERT_EQ(again.load_or_build(path, 8), 0);
+    EXPECT_EQ(again.load(path), 0);
+
+    //save replaces the sidecar by rename, a reader of the old one reads it whole
+    std::string index = LineIndex::index_path(path);
+    ASSERT_EQ(stat(index.c_str(), &st), 0);
+    std::ifstream old_index(index.c_str(), std::ios::binary);
+    ASSERT_EQ(again.build(path, 1), 0);
+    ASSERT_EQ(again.save(path), 0);
+    std::string old_content((std::istreambuf_iterator<char>(old_index)),
+            std::istreambuf_iterator<char>());
+    EXPECT_EQ(old_content.size(), static_cast<size_t>(st.st_size));
+    EXPECT_EQ(again.load(path), 0);
+    EXPECT_EQ(again.sample_every(), 1);
+    EXPECT_EQ(again.save(std::string("no_such_dir/") + path), -1);
+
+    //broken sidecar
+    std::ofstream broken(LineIndex::index_path(path).c_str(), std::ios::trunc);
+    broken << "broken";
+    broken.close();
+    EXPECT_EQ(again.load(path), -1);
+
+    remove(LineIndex::index_path(path).c_str());
+    remove(path);
+}
+
+//test DictParser seek to a line
+TEST(DictParser, seek_to_line) {
+    const char* path = "line_index_seek.txt";
+    write_dict(path, 3000, true);
+    LineIndex index;
+    ASSERT_EQ(index.build(path, 64), 0);
+
+    Parser<int> p0;
+    Parser<std::string> p1;
+    DictParser dp(path);
+    dp.add_column(&p0);
+    dp.add_column(&p1);
+    size_t lines[] = {2999, 0, 63, 64, 65, 1777};
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        ASSERT_EQ(dp.seek_to_line(index, lines[i]), 0);
+        ASSERT_EQ(dp.parse_next_line(), 0);
+        EXPECT_EQ(p0.data(), static_cast<int>(lines[i]));
+        EXPECT_EQ(p1.data().size(), lines[i] % 37 + 1);
+    }
+    //parse goes on after seek
+    ASSERT_EQ(dp.seek_to_line(index, 10), 0);
+    ASSERT_EQ(dp.parse_next_line(), 0);
+    ASSERT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 11);
+
+    EXPECT_EQ(dp.seek_to_line(index, 3000), -1);
+    remove(path);
+}
+
+//test MappedDict parse line ranges
+TEST(MappedDict, parse_lines) {
+    const char* path = "line_index_mapped.txt";
+    write_dict(path, 3000, false);
+    LineIndex index;
+    ASSERT_EQ(index.build(path, 100), 0);
+
+    MappedDict md(path);
+    ASSERT_TRUE(md.is_open());
+    Parser<int> p0;
+    Parser<std::string> p1;
+    md.add_column(&p0);
+    md.add_column(&p1);
+    ColumnCollector<Parser<int> > ids(&p0);
+
+    EXPECT_EQ(md.parse_lines(index, 150, 100, &ids), 100);
+    ASSERT_EQ(ids.result().size(), 100);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(ids.result()[i], 150 + i);
+    }
+
+    //stops at the end of the dict
+    ids.result().clear();
+    EXPECT_EQ(md.parse_lines(index, 2990, 100, &ids), 10);
+    EXPECT_EQ(ids.result().back(), 2999);
+    EXPECT_EQ(p1.data().size(), 2999 % 37 + 1);
+
+    EXPECT_EQ(md.parse_line(index, 1234, &ids), 0);
+    EXPECT_EQ(p0.data(), 1234);
+    EXPECT_EQ(md.parse_line(index, 3000, &ids), -1);
+    EXPECT_EQ(md.parse_lines(index, 0, 0, &ids), 0);
+
+    //index of another file
+    LineIndex other;
+    write_dict("line_index_other.txt", 10, true);
+    ASSERT_EQ(other.build("line_index_other.txt", 4), 0);
+    EXPECT_EQ(md.parse_lines(other, 0, 5, &ids), 0);
+    remove("line_index_other.txt");
+    remove(path);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
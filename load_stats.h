@@ -0,0 +1,147 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// distributions collected while profiling the load of a dict, used by dictstat
+
+#ifndef GOODCODER_LOAD_STATS_H
+#define GOODCODER_LOAD_STATS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <vector>
+
+namespace baidu {
+
+/**
+ * LengthStats keeps the exact distribution of lengths up to MAX_EXACT
+ * longer lengths share the last slot, a percentile falling there is reported as max()
+ */
+class LengthStats {
+public:
+    static const size_t MAX_EXACT = 4096;
+
+    LengthStats() : _count(0), _sum(0), _min(0), _max(0), _slots(MAX_EXACT + 1, 0) {};
+
+    void add(size_t len) {
+        if (_count == 0 || len < _min) {
+            _min = len;
+        }
+        if (len > _max) {
+            _max = len;
+        }
+        _count++;
+        _sum += len;
+        _slots[len < MAX_EXACT ? len : MAX_EXACT]++;
+    }
+
+    /**
+     * @brief the smallest length that at least p of the lengths are not longer than
+     * @param [in] double p, in [0, 1]
+     * @return size_t
+     * @retval 0:no length is added
+    **/
+    size_t percentile(double p) const {
+        if (_count == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(ceil(p * _count));
+        if (target == 0) {
+            target = 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < MAX_EXACT; i++) {
+            seen += _slots[i];
+            if (seen >= target) {
+                return i;
+            }
+        }
+        return _max;
+    }
+
+    uint64_t count() const {
+        return _count;
+    }
+
+    double average() const {
+        return _count == 0 ? 0 : static_cast<double>(_sum) / _count;
+    }
+
+    //0 when no length is added
+    size_t min() const {
+        return _min;
+    }
+
+    size_t max() const {
+        return _max;
+    }
+
+private:
+    uint64_t _count;
+    uint64_t _sum;
+    size_t _min;
+    size_t _max;
+    std::vector<uint64_t> _slots;
+};
+
+/**
+ * Histogram counts values in power of 2 buckets:
+ * bucket 0 holds 0, bucket b holds [2^(b-1), 2^b - 1]
+ */
+class Histogram {
+public:
+    void add(size_t v) {
+        _buckets[bucket(v)]++;
+    }
+
+    static size_t bucket(size_t v) {
+        size_t b = 0;
+        while (v != 0) {
+            v >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    static size_t low(size_t bucket) {
+        return bucket == 0 ? 0 : static_cast<size_t>(1) << (bucket - 1);
+    }
+
+    static size_t high(size_t bucket) {
+        return bucket == 0 ? 0 : (static_cast<size_t>(1) << (bucket - 1) << 1) - 1;
+    }
+
+    //count of every bucket not empty
+    const std::map<size_t, uint64_t>& buckets() const {
+        return _buckets;
+    }
+
+    /**
+     * @brief print every bucket with its share of total and a bar
+     * @param [in] const char* title
+     * @param [in] uint64_t total, number of values the shares are of
+     * @return void
+    **/
+    void print(const char* title, uint64_t total) const {
+        printf("%s\n", title);
+        for (std::map<size_t, uint64_t>::const_iterator it = _buckets.begin();
+                it != _buckets.end(); ++it) {
+            double share = total == 0 ? 0 : 100.0 * it->second / total;
+            printf("  %8zu - %-8zu %10llu %6.2f%% ", low(it->first), high(it->first),
+                    static_cast<unsigned long long>(it->second), share);
+            for (int i = 0; i < static_cast<int>(share / 2); i++) {
+                putchar('#');
+            }
+            putchar('\n');
+        }
+    }
+
+private:
+    std::map<size_t, uint64_t> _buckets;
+};
+
+}
+#endif // GOODCODER_LOAD_STATS_H
@@ -0,0 +1,81 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test LengthStats and Histogram
+
+#include <stdint.h>
+
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include "load_stats.h"
+
+namespace test {
+
+using baidu::LengthStats;
+using baidu::Histogram;
+
+//test min, max, average and percentiles
+TEST(LengthStats, percentile) {
+    LengthStats empty;
+    EXPECT_EQ(empty.count(), 0);
+    EXPECT_EQ(empty.percentile(0.5), 0);
+    EXPECT_EQ(empty.average(), 0);
+
+    LengthStats stats;
+    for (size_t len = 100; len >= 1; len--) {
+        stats.add(len);
+    }
+    EXPECT_EQ(stats.count(), 100);
+    EXPECT_EQ(stats.min(), 1);
+    EXPECT_EQ(stats.max(), 100);
+    EXPECT_DOUBLE_EQ(stats.average(), 50.5);
+    EXPECT_EQ(stats.percentile(0), 1);
+    EXPECT_EQ(stats.percentile(0.5), 50);
+    EXPECT_EQ(stats.percentile(0.99), 99);
+    EXPECT_EQ(stats.percentile(1), 100);
+
+    //lengths beyond the exact slots are reported as the max
+    LengthStats longs;
+    longs.add(0);
+    longs.add(LengthStats::MAX_EXACT + 10);
+    longs.add(LengthStats::MAX_EXACT * 3);
+    EXPECT_EQ(longs.min(), 0);
+    EXPECT_EQ(longs.percentile(0.3), 0);
+    EXPECT_EQ(longs.percentile(0.5), LengthStats::MAX_EXACT * 3);
+}
+
+//test power of 2 buckets
+TEST(Histogram, buckets) {
+    EXPECT_EQ(Histogram::bucket(0), 0);
+    EXPECT_EQ(Histogram::bucket(1), 1);
+    EXPECT_EQ(Histogram::bucket(2), 2);
+    EXPECT_EQ(Histogram::bucket(3), 2);
+    EXPECT_EQ(Histogram::bucket(4), 3);
+    EXPECT_EQ(Histogram::bucket(~static_cast<size_t>(0)), 64);
+    for (size_t b = 1; b <= 64; b++) {
+        EXPECT_EQ(Histogram::bucket(Histogram::low(b)), b);
+        EXPECT_EQ(Histogram::bucket(Histogram::high(b)), b);
+    }
+    EXPECT_EQ(Histogram::high(64), ~static_cast<size_t>(0));
+
+    Histogram h;
+    h.add(0);
+    h.add(5);
+    h.add(6);
+    h.add(7);
+    h.add(1000);
+    const std::map<size_t, uint64_t>& buckets = h.buckets();
+    ASSERT_EQ(buckets.size(), 3);
+    EXPECT_EQ(buckets.at(0), 1);
+    EXPECT_EQ(buckets.at(3), 3);
+    EXPECT_EQ(buckets.at(10), 1);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
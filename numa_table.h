@@ -0,0 +1,338 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// NUMA topology, thread binding and node-aware placement of loaded columns
+// pages are placed by first touch, so no libnuma is needed
+
+#ifndef GOODCODER_NUMA_TABLE_H
+#define GOODCODER_NUMA_TABLE_H
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "parser.h"
+#include "huge_page.h"
+
+namespace baidu {
+
+/**
+ * NumaPolicy decides where the pages of a loaded column live
+ * NUMA_REPLICATE : every node has its own copy, readers use the local one
+ * NUMA_INTERLEAVE : one copy, pages are spread over the nodes round-robin
+ */
+enum NumaPolicy {
+    NUMA_REPLICATE = 0,
+    NUMA_INTERLEAVE = 1,
+};
+
+/**
+ * NumaTopology is the cpu list of every NUMA node
+ * detect() reads it from sysfs, simulate() splits the cpus of this box into
+ * fake nodes, so that the NUMA code path can run on a single node box
+ * nodes are indexed from 0 to node_num() - 1, node_id() is the id of a node in the box,
+ * the ids may have holes
+ */
+class NumaTopology {
+public:
+    NumaTopology() {};
+
+    /**
+     * @brief read the topology of the online nodes from /sys/devices/system/node
+     *        nodes without cpus, such as memory-only nodes, are skipped,
+     *        no thread can be bound there to touch the pages
+     * @param [in] const std::string& root, the sysfs node directory
+     * @return NumaTopology
+     * @retval one node with all cpus when sysfs is not available
+    **/
+    static NumaTopology detect(const std::string& root = "/sys/devices/system/node") {
+        NumaTopology topo;
+        std::ifstream online((root + "/online").c_str());
+        std::string list;
+        std::getline(online, list);
+        //the node list has the format of a cpu list, such as "0,2-3"
+        std::vector<int> ids = parse_cpu_list(list);
+        for (size_t i = 0; i < ids.size(); i++) {
+            std::ifstream fs((root + "/node" + std::to_string(ids[i]) + "/cpulist").c_str());
+            std::string cpus;
+            if (std::getline(fs, cpus) && !parse_cpu_list(cpus).empty()) {
+                topo.add_node(parse_cpu_list(cpus), ids[i]);
+            }
+        }
+        if (topo.node_num() == 0) {
+            return simulate(1);
+        }
+        return topo;
+    }
+
+    /**
+     * @brief split the online cpus into node_num fake nodes round-robin
+     *        a node gets all cpus when there are less cpus than nodes
+     * @param [in] size_t node_num
+     * @return NumaTopology
+    **/
+    static NumaTopology simulate(size_t node_num) {
+        long cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpu_num < 1) {
+            cpu_num = 1;
+        }
+        NumaTopology topo;
+        for (size_t node = 0; node < node_num; node++) {
+            std::vector<int> cpus;
+            for (long cpu = 0; cpu < cpu_num; cpu++) {
+                if (static_cast<size_t>(cpu) % node_num == node
+                        || static_cast<size_t>(cpu_num) < node_num) {
+                    cpus.push_back(static_cast<int>(cpu));
+                }
+            }
+            topo.add_node(cpus);
+        }
+        return topo;
+    }
+
+    /**
+     * @brief parse a sysfs cpu list such as "0-3,8,10-11"
+     * @param [in] std::string list
+     * @return std::vector<int>
+     * @retval the cpus, empty when list is invalid
+    **/
+    static std::vector<int> parse_cpu_list(const std::string& list) {
+        std::vector<int> cpus;
+        const char* p = list.c_str();
+        while (*p != '\0' && *p != '\n') {
+            char* end = NULL;
+            long first = strtol(p, &end, 10);
+            long last = first;
+            if (end == p || first < 0) {
+                return std::vector<int>();
+            }
+            if (*end == '-') {
+                p = end + 1;
+                last = strtol(p, &end, 10);
+                if (end == p || last < first) {
+                    return std::vector<int>();
+                }
+            }
+            if (*end != ',' && *end != '\0' && *end != '\n') {
+                return std::vector<int>();
+            }
+            for (long cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+            p = (*end == ',') ? end + 1 : end;
+        }
+        return cpus;
+    }
+
+    /**
+     * @brief add a node
+     * @param [in] const std::vector<int>& cpus
+     * @param [in] int id, the id of the node in the box, -1 for its index
+     * @return void
+    **/
+    void add_node(const std::vector<int>& cpus, int id = -1) {
+        _ids.push_back(id < 0 ? static_cast<int>(_nodes.size()) : id);
+        _nodes.push_back(cpus);
+    }
+
+    size_t node_num() const {
+        return _nodes.size();
+    }
+
+    const std::vector<int>& cpus(size_t node) const {
+        return _nodes[node];
+    }
+
+    //id of the node in the box, such as the N of /sys/devices/system/node/nodeN
+    int node_id(size_t node) const {
+        return _ids[node];
+    }
+
+    /**
+     * @brief bind the calling thread to the cpus of a node
+     *        current_node() of this thread returns node afterwards
+     * @param [in] size_t node
+     * @return int
+     * @retval 0:succeed, -1:invalid node or sched_setaffinity failed
+    **/
+    int bind_thread(size_t node) const {
+        if (node >= _nodes.size() || _nodes[node].empty()) {
+            return -1;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < _nodes[node].size(); i++) {
+            CPU_SET(_nodes[node][i], &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            return -1;
+        }
+        bound_node() = static_cast<int>(node);
+        return 0;
+    }
+
+    /**
+     * @brief get the node of the calling thread
+     * @return size_t
+     * @retval the node given to bind_thread, or the node of the running cpu
+    **/
+    size_t current_node() const {
+        int node = bound_node();
+        if (node >= 0 && static_cast<size_t>(node) < _nodes.size()) {
+            return node;
+        }
+        int cpu = sched_getcpu();
+        for (size_t i = 0; i < _nodes.size(); i++) {
+            for (size_t j = 0; j < _nodes[i].size(); j++) {
+                if (_nodes[i][j] == cpu) {
+                    return i;
+                }
+            }
+        }
+        return 0;
+    }
+
+private:
+    static int& bound_node() {
+        static thread_local int node = -1;
+        return node;
+    }
+
+    std::vector<std::vector<int> > _nodes;
+    std::vector<int> _ids;
+};
+
+/**
+ * NumaColumn is a read-only column placed on the nodes of a NumaTopology
+ * the pages are written by threads bound to the target node, so the kernel
+ * allocates them there by first touch
+ * T should be a trivial type, such as int, float or uint32_t codes of a StringPool
+ * with a huge page mode, every copy is mapped by map_region, and NUMA_INTERLEAVE
+ * places whole huge pages, since the kernel places a huge page at its first touch
+ * there is no operator[], a reader takes local() once and indexes it:
+ *   const float* scores = col.local();
+ *   ...scores[i]...
+ */
+template <typename T>
+class NumaColumn {
+public:
+    static_assert(std::is_trivial<T>::value, "NumaColumn only holds trivial types");
+
+    NumaColumn(const NumaTopology& topo, NumaPolicy policy, HugePageMode mode = HUGE_PAGE_NONE) :
+            _topo(topo), _policy(policy), _mode(mode), _size(0), _bytes(0) {};
+
+    ~NumaColumn() {
+        clear();
+    }
+
+    /**
+     * @brief copy a loaded column to the nodes
+     * @param [in] const T* src
+     * @param [in] size_t n, number of elements
+     * @return int
+     * @retval 0:succeed, -1:out of memory
+    **/
+    int load(const T* src, size_t n) {
+        clear();
+        if (n == 0) {
+            return 0;
+        }
+        size_t node_num = std::max<size_t>(_topo.node_num(), 1);
+        size_t copies = (_policy == NUMA_REPLICATE) ? node_num : 1;
+        _bytes = n * sizeof(T);
+        for (size_t i = 0; i < copies; i++) {
+            PageRegion region;
+            if (map_region(_bytes, _mode, &region) != 0) {
+                clear();
+                return -1;
+            }
+            _regions.push_back(region);
+            _copies.push_back(static_cast<T*>(region.addr));
+        }
+        _size = n;
+
+        std::vector<std::thread> threads;
+        for (size_t node = 0; node < node_num; node++) {
+            threads.push_back(std::thread(&NumaColumn::touch, this, src, node, node_num));
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        return 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    //the copy used by a node
+    const T* data(size_t node) const {
+        if (_copies.empty()) {
+            return NULL;
+        }
+        return _copies[_policy == NUMA_REPLICATE ? node % _copies.size() : 0];
+    }
+
+    /**
+     * @brief the copy of the node running the calling thread
+     *        finding the node may call sched_getcpu and scan the cpu lists,
+     *        so call it once for a thread or a request, and index the copy it returns
+     * @return const T*
+     * @retval NULL:nothing is loaded
+    **/
+    const T* local() const {
+        return data(_topo.current_node());
+    }
+
+    //regions of the copies, see huge_backed_bytes
+    const std::vector<PageRegion>& regions() const {
+        return _regions;
+    }
+
+private:
+    //called by a thread bound to node, writes the pages owned by node
+    void touch(const T* src, size_t node, size_t node_num) {
+        _topo.bind_thread(node);
+        if (_policy == NUMA_REPLICATE) {
+            memcpy(_copies[node], src, _bytes);
+            return;
+        }
+        size_t page = (_regions[0].mode == HUGE_PAGE_NONE) ?
+                static_cast<size_t>(sysconf(_SC_PAGESIZE)) : HUGE_PAGE_SIZE;
+        char* dst = reinterpret_cast<char*>(_copies[0]);
+        const char* from = reinterpret_cast<const char*>(src);
+        for (size_t off = node * page; off < _bytes; off += node_num * page) {
+            memcpy(dst + off, from + off, std::min(page, _bytes - off));
+        }
+    }
+
+    void clear() {
+        for (size_t i = 0; i < _regions.size(); i++) {
+            unmap_region(&_regions[i]);
+        }
+        _regions.clear();
+        _copies.clear();
+        _size = 0;
+        _bytes = 0;
+    }
+
+    NumaTopology _topo;
+    NumaPolicy _policy;
+    HugePageMode _mode;
+    std::vector<PageRegion> _regions;
+    std::vector<T*> _copies;
+    size_t _size;
+    size_t _bytes;
+    DISALLOW_COPY_AND_ASSIGN(NumaColumn);
+};
+
+}
+#endif // GOODCODER_NUMA_TABLE_H
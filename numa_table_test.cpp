@@ -0,0 +1,232 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test NumaTopology, NumaColumn and numa-bound parallel load
+// the topology is simulated, so the test runs on a single node box
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "aggregator.h"
+#include "numa_table.h"
+#include "parallel_parser.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::RowVisitor;
+using baidu::ColumnCollector;
+using baidu::ParallelDictParser;
+using baidu::NumaTopology;
+using baidu::NumaColumn;
+using baidu::NUMA_REPLICATE;
+using baidu::NUMA_INTERLEAVE;
+
+//test parse sysfs cpu list
+TEST(NumaTopology, parse_cpu_list) {
+    std::vector<int> cpus = NumaTopology::parse_cpu_list("0-3,8,10-11\n");
+    ASSERT_EQ(cpus.size(), 7);
+    EXPECT_EQ(cpus[0], 0);
+    EXPECT_EQ(cpus[3], 3);
+    EXPECT_EQ(cpus[4], 8);
+    EXPECT_EQ(cpus[6], 11);
+    EXPECT_EQ(NumaTopology::parse_cpu_list("0").size(), 1);
+    EXPECT_TRUE(NumaTopology::parse_cpu_list("").empty());
+    EXPECT_TRUE(NumaTopology::parse_cpu_list("3-1").empty());
+    EXPECT_TRUE(NumaTopology::parse_cpu_list("a-b").empty());
+    EXPECT_TRUE(NumaTopology::parse_cpu_list("1;2").empty());
+}
+
+//test detect and simulate topology
+TEST(NumaTopology, simulate) {
+    NumaTopology real = NumaTopology::detect();
+    EXPECT_GE(real.node_num(), 1);
+
+    NumaTopology topo = NumaTopology::simulate(2);
+    ASSERT_EQ(topo.node_num(), 2);
+    EXPECT_FALSE(topo.cpus(0).empty());
+    EXPECT_FALSE(topo.cpus(1).empty());
+    EXPECT_EQ(topo.bind_thread(2), -1);
+
+    size_t nodes[2] = {9, 9};
+    for (size_t i = 0; i < 2; i++) {
+        std::thread t([&topo, &nodes, i]() {
+            if (topo.bind_thread(i) == 0) {
+                nodes[i] = topo.current_node();
+            }
+        });
+        t.join();
+    }
+    EXPECT_EQ(nodes[0], 0);
+    EXPECT_EQ(nodes[1], 1);
+}
+
+//test node ids with holes and nodes without cpus
+TEST(NumaTopology, sparse_nodes) {
+    const char* root = "numa_nodes";
+    const char* dirs[] = {"numa_nodes/node0", "numa_nodes/node2", "numa_nodes/node3"};
+    const char* lists[] = {"0-1\n", "2,3\n", "\n"};
+    mkdir(root, 0755);
+    for (size_t i = 0; i < 3; i++) {
+        mkdir(dirs[i], 0755);
+        std::ofstream((std::string(dirs[i]) + "/cpulist").c_str()) << lists[i];
+    }
+    std::ofstream((std::string(root) + "/online").c_str()) << "0,2-3\n";
+
+    NumaTopology topo = NumaTopology::detect(root);
+    ASSERT_EQ(topo.node_num(), 2);
+    EXPECT_EQ(topo.node_id(0), 0);
+    EXPECT_EQ(topo.node_id(1), 2);
+    ASSERT_EQ(topo.cpus(1).size(), 2);
+    EXPECT_EQ(topo.cpus(1)[0], 2);
+    EXPECT_EQ(topo.cpus(1)[1], 3);
+
+    for (size_t i = 0; i < 3; i++) {
+        remove((std::string(dirs[i]) + "/cpulist").c_str());
+        rmdir(dirs[i]);
+    }
+    remove((std::string(root) + "/online").c_str());
+    rmdir(root);
+
+    NumaTopology missing = NumaTopology::detect(root);
+    ASSERT_EQ(missing.node_num(), 1);
+    EXPECT_EQ(missing.node_id(0), 0);
+}
+
+//test every node reads its own copy
+TEST(NumaColumn, replicate) {
+    NumaTopology topo = NumaTopology::simulate(2);
+    std::vector<int> src;
+    for (int i = 0; i < 100000; i++) {
+        src.push_back(i * 3);
+    }
+    NumaColumn<int> col(topo, NUMA_REPLICATE);
+    EXPECT_EQ(col.data(0), (const int*)NULL);
+    ASSERT_EQ(col.load(&src[0], src.size()), 0);
+    ASSERT_EQ(col.size(), src.size());
+    EXPECT_NE(col.data(0), col.data(1));
+    EXPECT_EQ(memcmp(col.data(0), &src[0], src.size() * sizeof(int)), 0);
+    EXPECT_EQ(memcmp(col.data(1), &src[0], src.size() * sizeof(int)), 0);
+
+    const int* local[2] = {NULL, NULL};
+    int value[2] = {0, 0};
+    for (size_t i = 0; i < 2; i++) {
+        std::thread t([&, i]() {
+            topo.bind_thread(i);
+            local[i] = col.local();
+            value[i] = local[i][12345];
+        });
+        t.join();
+    }
+    EXPECT_EQ(local[0], col.data(0));
+    EXPECT_EQ(local[1], col.data(1));
+    EXPECT_EQ(value[0], 12345 * 3);
+    EXPECT_EQ(value[1], 12345 * 3);
+
+    ASSERT_EQ(col.load(NULL, 0), 0);
+    EXPECT_EQ(col.size(), 0);
+}
+
+//test one copy spread over the nodes
+TEST(NumaColumn, interleave) {
+    NumaTopology topo = NumaTopology::simulate(3);
+    std::vector<double> src;
+    for (int i = 0; i < 100001; i++) {
+        src.push_back(i * 0.5);
+    }
+    NumaColumn<double> col(topo, NUMA_INTERLEAVE);
+    ASSERT_EQ(col.load(&src[0], src.size()), 0);
+    EXPECT_EQ(col.data(0), col.data(2));
+    EXPECT_EQ(memcmp(col.data(0), &src[0], src.size() * sizeof(double)), 0);
+    EXPECT_DOUBLE_EQ(col.local()[100000], 50000);
+}
+
+//record the node of every worker
+class NodeRecorder : public RowVisitor {
+public:
+    NodeRecorder(const NumaTopology* topo, std::set<size_t>* nodes, std::mutex* mutex) :
+            _topo(topo), _nodes(nodes), _mutex(mutex) {};
+
+    virtual void visit() override {
+        std::lock_guard<std::mutex> lock(*_mutex);
+        _nodes->insert(_topo->current_node());
+    }
+private:
+    const NumaTopology* _topo;
+    std::set<size_t>* _nodes;
+    std::mutex* _mutex;
+};
+
+//test parallel load with workers bound to nodes, then place the column
+TEST(ParallelDictParser, numa) {
+    const char* path = "numa_load.txt";
+    const int lines = 20000;
+    std::ofstream out(path);
+    for (int i = 0; i < lines; i++) {
+        out << i << "\n";
+    }
+    out.close();
+
+    NumaTopology topo = NumaTopology::simulate(2);
+    std::set<size_t> nodes;
+    std::mutex mutex;
+    const int n = 4;
+    Parser<int> columns[n];
+    LineParser lps[n];
+    std::vector<ColumnCollector<Parser<int> >*> collectors;
+    std::vector<NodeRecorder*> recorders;
+    std::vector<baidu::VisitorGroup*> groups;
+    ParallelDictParser pdp(path);
+    pdp.set_topology(&topo);
+    for (int i = 0; i < n; i++) {
+        lps[i].add_parser(&columns[i]);
+        collectors.push_back(new ColumnCollector<Parser<int> >(&columns[i]));
+        recorders.push_back(new NodeRecorder(&topo, &nodes, &mutex));
+        groups.push_back(new baidu::VisitorGroup());
+        groups[i]->add_visitor(collectors[i]);
+        groups[i]->add_visitor(recorders[i]);
+        pdp.add_worker(&lps[i], groups[i]);
+    }
+    ASSERT_EQ(pdp.parse(), 0);
+    EXPECT_EQ(pdp.good_lines(), lines);
+    EXPECT_EQ(nodes.size(), 2);
+
+    for (int i = 1; i < n; i++) {
+        collectors[0]->merge(*collectors[i]);
+    }
+    std::vector<int>& loaded = collectors[0]->result();
+    ASSERT_EQ(loaded.size(), lines);
+    for (int i = 0; i < lines; i++) {
+        ASSERT_EQ(loaded[i], i);
+    }
+    NumaColumn<int> col(topo, NUMA_REPLICATE);
+    ASSERT_EQ(col.load(&loaded[0], loaded.size()), 0);
+    EXPECT_EQ(col.local()[lines - 1], lines - 1);
+
+    for (int i = 0; i < n; i++) {
+        delete collectors[i];
+        delete recorders[i];
+        delete groups[i];
+    }
+    remove(path);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
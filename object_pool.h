@@ -0,0 +1,94 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// ObjectPool keeps preallocated column objects for reuse
+
+#ifndef GOODCODER_OBJECT_POOL_H
+#define GOODCODER_OBJECT_POOL_H
+
+#include <stddef.h>
+
+#include <mutex>
+#include <vector>
+
+#include "parser.h"
+
+namespace baidu {
+
+/**
+ * ObjectPool holds objects of type T which are released but not freed,
+ * so the memory owned by them (vector or string capacity) is reused
+ * a typical usage is swapping data() of a Parser with an acquired object:
+ *     T* obj = pool.acquire();
+ *     std::swap(*obj, parser.data());
+ * the row is moved to obj and parser gets the capacity of an old object
+ * it is thread-safe, workers of ParallelDictParser may share one pool
+ */
+template <typename T>
+class ObjectPool {
+public:
+    /**
+     * @param [in] size_t n, number of objects to preallocate
+    **/
+    explicit ObjectPool(size_t n = 0) : _created(0) {
+        _free.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            _free.push_back(new T());
+        }
+        _created = n;
+    }
+
+    ~ObjectPool() {
+        for (size_t i = 0; i < _free.size(); i++) {
+            delete _free[i];
+        }
+    }
+
+    /**
+     * @brief get an object, create a new one only when the pool is empty
+     * @return T*
+     * @retval the object keeps the content it had when released
+    **/
+    T* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_free.empty()) {
+                T* obj = _free.back();
+                _free.pop_back();
+                return obj;
+            }
+            _created++;
+        }
+        return new T();
+    }
+
+    /**
+     * @brief give an object back to the pool
+     * @param [in] T* obj, should be returned by acquire of this pool
+    **/
+    void release(T* obj) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(obj);
+    }
+
+    //number of objects created by this pool, it stops growing in steady state
+    size_t created() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _created;
+    }
+
+    //number of objects waiting in the pool
+    size_t available() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _free.size();
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::vector<T*> _free;
+    size_t _created;
+    DISALLOW_COPY_AND_ASSIGN(ObjectPool);
+};
+
+}
+#endif // GOODCODER_OBJECT_POOL_H
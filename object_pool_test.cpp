@@ -0,0 +1,193 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test parse into existing objects and ObjectPool
+
+#include <stdlib.h>
+
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "object_pool.h"
+
+//count the heap allocations of this test
+static size_t g_alloc_count = 0;
+
+void* operator new(size_t size) {
+    g_alloc_count++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+namespace test {
+
+using baidu::Parse;
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::HasParseInto;
+using baidu::ObjectPool;
+
+//user defined structure holding heap memory
+struct Feature {
+    int id;
+    std::vector<int> ids;
+};
+
+//user defined class which parse "id;id0,id1,..." into an existing Feature
+class FeatureParse {
+public:
+    void operator()(const std::string& s, Feature& f) const {
+        const char* p = s.c_str();
+        char* end = NULL;
+        f.id = static_cast<int>(strtol(p, &end, 10));
+        if (end == p || *end != ';') {
+            throw std::invalid_argument("can not find ';' for feature");
+        }
+        f.ids.clear();
+        while (*end != '\0') {
+            p = end + 1;
+            f.ids.push_back(static_cast<int>(strtol(p, &end, 10)));
+            if (end == p || (*end != ',' && *end != '\0')) {
+                throw std::invalid_argument("parse feature ids");
+            }
+        }
+    }
+};
+
+//user defined class in the old protocol, return a new object
+class FeatureCopyParse {
+public:
+    Feature operator()(const std::string& s) const {
+        Feature f;
+        FeatureParse()(s, f);
+        return f;
+    }
+};
+
+//test which parse classes can parse into an existing object
+TEST(HasParseInto, detect) {
+    EXPECT_TRUE((HasParseInto<Feature, FeatureParse>::value));
+    EXPECT_FALSE((HasParseInto<Feature, FeatureCopyParse>::value));
+    EXPECT_TRUE((HasParseInto<std::string, Parse<std::string> >::value));
+    EXPECT_TRUE((HasParseInto<std::vector<int>, Parse<std::vector<int> > >::value));
+    EXPECT_FALSE((HasParseInto<int, Parse<int> >::value));
+}
+
+//both protocols give the same result
+TEST(Parser, parse_into) {
+    Parser<Feature, FeatureParse> p0;
+    Parser<Feature, FeatureCopyParse> p1;
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+
+    EXPECT_EQ(lp.parse("7;1,2,3\t7;1,2,3"), 0);
+    EXPECT_EQ(p0.data().id, 7);
+    ASSERT_EQ(p0.data().ids.size(), 3);
+    EXPECT_EQ(p0.data().ids[2], 3);
+    EXPECT_EQ(p1.data().id, 7);
+    EXPECT_EQ(p1.data().ids, p0.data().ids);
+
+    EXPECT_EQ(lp.parse("8;4\t8;4"), 0);
+    ASSERT_EQ(p0.data().ids.size(), 1);
+    EXPECT_EQ(p0.data().ids, p1.data().ids);
+
+    EXPECT_EQ(lp.parse("8;4,\t8;4"), -1);
+    EXPECT_EQ(lp.parse("8\t8;4"), -1);
+}
+
+//parse into existing objects does not allocate in steady state
+TEST(Parser, no_allocation) {
+    Parser<Feature, FeatureParse> p0;
+    Parser<std::vector<int>> p1;
+    Parser<std::string> p2;
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+    lp.add_parser(&p2);
+    std::string line0("1;1,2,3,4,5,6,7,8\t8:1,2,3,4,5,6,7,8\ta string longer than sso");
+    std::string line1("2;8,7,6,5,4,3,2,1\t8:8,7,6,5,4,3,2,1\tanother string longer than sso");
+    ASSERT_EQ(lp.parse(line0), 0);
+    ASSERT_EQ(lp.parse(line1), 0);
+
+    size_t before = g_alloc_count;
+    int ret = 0;
+    for (int i = 0; i < 1000; i++) {
+        ret |= lp.parse(i % 2 == 0 ? line0 : line1);
+    }
+    size_t allocs = g_alloc_count - before;
+    EXPECT_EQ(ret, 0);
+    EXPECT_EQ(allocs, 0);
+    EXPECT_EQ(p0.data().ids[0], 8);
+    EXPECT_EQ(p1.data()[7], 1);
+}
+
+//test ObjectPool reuse the released objects
+TEST(ObjectPool, reuse) {
+    ObjectPool<Feature> pool(4);
+    EXPECT_EQ(pool.created(), 4);
+    EXPECT_EQ(pool.available(), 4);
+
+    Parser<Feature, FeatureParse> p0;
+    LineParser lp;
+    lp.add_parser(&p0);
+    std::vector<Feature*> batch;
+    std::vector<std::string> lines;
+    for (int i = 0; i < 4; i++) {
+        lines.push_back(std::to_string(i) + ";1,2,3,4,5,6,7,8,9,10");
+    }
+    batch.reserve(4);
+
+    //first round warms up the capacity of every object
+    for (int round = 0; round < 10; round++) {
+        if (round == 2) {
+            g_alloc_count = 0;
+        }
+        for (int i = 0; i < 4; i++) {
+            ASSERT_EQ(lp.parse(lines[i]), 0);
+            Feature* obj = pool.acquire();
+            std::swap(*obj, p0.data());
+            batch.push_back(obj);
+        }
+        EXPECT_EQ(batch[3]->id, 3);
+        EXPECT_EQ(batch[0]->ids.size(), 10);
+        for (size_t i = 0; i < batch.size(); i++) {
+            pool.release(batch[i]);
+        }
+        batch.clear();
+    }
+    EXPECT_EQ(g_alloc_count, 0);
+    EXPECT_EQ(pool.created(), 4);
+
+    //pool grows when empty
+    Feature* more[5];
+    for (int i = 0; i < 5; i++) {
+        more[i] = pool.acquire();
+    }
+    EXPECT_EQ(pool.created(), 5);
+    EXPECT_EQ(pool.available(), 0);
+    for (int i = 0; i < 5; i++) {
+        pool.release(more[i]);
+    }
+    EXPECT_EQ(pool.available(), 5);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,160 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// ParallelDictParser parse one file with several threads
+
+#ifndef GOODCODER_PARALLEL_PARSER_H
+#define GOODCODER_PARALLEL_PARSER_H
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+
+#include <com_log.h>
+
+#include "parser.h"
+#include "numa_table.h"
+
+namespace baidu {
+
+/**
+ * ParallelDictParser splits a file into byte ranges, one range for each worker
+ * a worker owns the lines which start in its range, and it has its own
+ * LineParser and RowVisitor, so workers never share a Parser object
+ * after parse() returns, merge the visitors of all workers
+ */
+class ParallelDictParser {
+public:
+    explicit ParallelDictParser(const std::string& path) : _path(path), _topo(NULL) {};
+
+    /**
+     * @brief bind worker i to node i % node_num of topo, so the memory
+     *        filled by a worker's visitor is placed on its node
+     * @param [in] const NumaTopology* topo, NULL for no binding
+     * @return void
+    **/
+    void set_topology(const NumaTopology* topo) {
+        _topo = topo;
+    }
+
+    /**
+     * @brief add a worker thread
+     * @param [in] LineParser* lp, parse the lines of this worker
+     * @param [in] RowVisitor* visitor, called after every valid line of this worker
+     * @return void
+    **/
+    void add_worker(LineParser* lp, RowVisitor* visitor) {
+        Worker w;
+        w.lp = lp;
+        w.visitor = visitor;
+        w.good = 0;
+        w.bad = 0;
+        _workers.push_back(w);
+    }
+
+    /**
+     * @brief parse the whole file, block until all workers finished
+     * @param
+     * @return int
+     * @retval 0:succeed, -1:no worker or the file can not be opened
+    **/
+    int parse() {
+        struct stat st;
+        if (_workers.empty() || stat(_path.c_str(), &st) != 0) {
+            return -1;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        size_t step = size / _workers.size() + 1;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < _workers.size(); i++) {
+            size_t begin = std::min(size, i * step);
+            size_t end = std::min(size, begin + step);
+            _workers[i].good = 0;
+            _workers[i].bad = 0;
+            threads.push_back(std::thread(run, _path, begin, end, _topo, i, &_workers[i]));
+        }
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        return 0;
+    }
+
+    size_t good_lines() const {
+        size_t n = 0;
+        for (size_t i = 0; i < _workers.size(); i++) {
+            n += _workers[i].good;
+        }
+        return n;
+    }
+
+    size_t bad_lines() const {
+        size_t n = 0;
+        for (size_t i = 0; i < _workers.size(); i++) {
+            n += _workers[i].bad;
+        }
+        return n;
+    }
+
+private:
+    struct Worker {
+        LineParser* lp;
+        RowVisitor* visitor;
+        size_t good;
+        size_t bad;
+    };
+
+    /**
+     * @brief parse the lines which start in [begin, end)
+    **/
+    static void run(const std::string& path, size_t begin, size_t end,
+            const NumaTopology* topo, size_t index, Worker* w) {
+        if (begin >= end) {
+            return;
+        }
+        if (topo != NULL && topo->node_num() > 0
+                && topo->bind_thread(index % topo->node_num()) != 0) {
+            CWARNING_LOG("bind worker %zu to numa node failed", index);
+        }
+        std::ifstream fs(path.c_str());
+        std::string line;
+        size_t max_length = parse_limits().max_line_length;
+        size_t pos = begin;
+        size_t consumed = 0;
+        int ret = 0;
+        if (begin > 0) {
+            //the line crossing begin belongs to the previous worker
+            fs.seekg(begin - 1);
+            if (read_line(fs, line, max_length, &consumed) > 0) {
+                return;
+            }
+            pos = begin - 1 + consumed;
+        }
+        //counted in locals, the Worker structs of all threads share cache lines
+        size_t good = 0;
+        size_t bad = 0;
+        while (pos < end && (ret = read_line(fs, line, max_length, &consumed)) <= 0) {
+            pos += consumed;
+            if (ret == 0 && w->lp->parse(line) == 0) {
+                w->visitor->visit();
+                good++;
+            } else {
+                report_error(PARSE_ERROR_LINE, "line format error");
+                bad++;
+            }
+        }
+        w->good = good;
+        w->bad = bad;
+    }
+
+    std::string _path;
+    const NumaTopology* _topo;
+    std::vector<Worker> _workers;
+    DISALLOW_COPY_AND_ASSIGN(ParallelDictParser);
+};
+
+}
+#endif // GOODCODER_PARALLEL_PARSER_H
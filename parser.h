@@ -6,11 +6,19 @@
 #ifndef GOODCODER_PARSER_H
 #define GOODCODER_PARSER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
 #include <vector>
-#include <sstream>
+#include <array>
+#include <atomic>
 #include <stdexcept>
 #include <fstream>
+#include <istream>
+#include <chrono>
+#include <type_traits>
+#include <utility>
 
 #include <com_log.h>
 
@@ -20,6 +28,143 @@
 
 namespace baidu {
 
+/**
+ * ParseLimits are hard limits checked before any work is done on a line,
+ * so that no garbage or malicious row can stall a load or exhaust memory
+ * change them by parse_limits() before parsing starts
+ */
+struct ParseLimits {
+    //longer lines are skipped without being stored
+    size_t max_line_length;
+    //LineParser refuses more columns than this
+    size_t max_columns;
+    //max 'num' of a 'num:item1,item2' array column
+    size_t max_array_count;
+
+    ParseLimits() : max_line_length(16 << 20), max_columns(4096), max_array_count(1 << 20) {};
+};
+
+/**
+ * @brief the limits used by all parsers of this process
+ * @return ParseLimits&
+**/
+inline ParseLimits& parse_limits() {
+    static ParseLimits limits;
+    return limits;
+}
+
+//kinds of errors reported to the ErrorSink
+enum ParseError {
+    //a column can not be parsed, 'what' is the reason
+    PARSE_ERROR_COLUMN = 0,
+    //a line is skipped
+    PARSE_ERROR_LINE = 1,
+};
+
+/**
+ * ErrorSink receives the errors of parsing
+ * it is called by every parse thread, so it must be thread-safe and return quickly
+ */
+class ErrorSink {
+public:
+    virtual void report(ParseError error, const char* what) = 0;
+    virtual ~ErrorSink() {};
+};
+
+/**
+ * ComLogSink writes every error to com_log at once, it is the default sink
+ */
+class ComLogSink : public ErrorSink {
+public:
+    virtual void report(ParseError error, const char* what) override {
+        if (error == PARSE_ERROR_COLUMN) {
+            CNOTICE_LOG("parse error:%s", what);
+        } else {
+            CNOTICE_LOG("%s", what);
+        }
+    }
+};
+
+inline ErrorSink* default_error_sink() {
+    static ComLogSink sink;
+    return &sink;
+}
+
+inline std::atomic<ErrorSink*>& error_sink_holder() {
+    static std::atomic<ErrorSink*> sink(default_error_sink());
+    return sink;
+}
+
+/**
+ * @brief the sink used by all parsers of this process
+ * @return ErrorSink*
+**/
+inline ErrorSink* error_sink() {
+    return error_sink_holder().load(std::memory_order_acquire);
+}
+
+/**
+ * @brief replace the sink, the old one may still be called by running parse threads
+ * @param [in] ErrorSink* sink, NULL for the default ComLogSink
+ * @return void
+**/
+inline void set_error_sink(ErrorSink* sink) {
+    error_sink_holder().store(sink != NULL ? sink : default_error_sink(),
+            std::memory_order_release);
+}
+
+inline void report_error(ParseError error, const char* what) {
+    error_sink()->report(error, what);
+}
+
+/**
+ * @brief read a line without storing more than max_length chars
+ *        a longer line is consumed up to '\n' and dropped
+ * @param [in] std::istream is
+ * @param [out] std::string line, without '\n'
+ * @param [in] size_t max_length
+ * @param [out] size_t* consumed, number of bytes consumed including '\n', may be NULL
+ * @param [in] char eol, the line terminator
+ * @return int
+ * @retval 0:read a line, -1:the line is too long, 1:nothing left
+**/
+inline int read_line(std::istream& is, std::string& line, size_t max_length,
+        size_t* consumed, char eol = '\n') {
+    char buf[4096];
+    size_t total = 0;
+    bool too_long = false;
+    line.clear();
+    while (true) {
+        is.getline(buf, sizeof(buf), eol);
+        size_t n = static_cast<size_t>(is.gcount());
+        if (n == 0) {
+            break;
+        }
+        total += n;
+        //buf is full without '\n', the line goes on
+        bool partial = is.fail() && !is.eof() && n == sizeof(buf) - 1;
+        size_t len = (partial || is.eof()) ? n : n - 1;
+        if (!too_long && line.size() + len > max_length) {
+            too_long = true;
+            line.clear();
+        }
+        if (!too_long) {
+            line.append(buf, len);
+        }
+        if (!partial) {
+            break;
+        }
+        is.clear(is.rdstate() & ~std::ios::failbit);
+    }
+    if (consumed != NULL) {
+        *consumed = total;
+    }
+    if (total == 0) {
+        return 1;
+    }
+    return too_long ? -1 : 0;
+}
+
 /**
  * Parse is a function-like template class just like std::unordered_map::hash<Key>
  * it's operator() is used to parse a string column
@@ -81,10 +226,247 @@ public:
     std::string operator()(const std::string& s) const {
         return s;
     }
+
+    //parse into an existing string, reuse its capacity
+    void operator()(const std::string& s, std::string& t) const {
+        t.assign(s);
+    }
+};
+
+/**
+ * HasParseInto judge whether 'pars' can parse into an existing object,
+ * that is, whether pars()(const std::string&, T&) is callable
+ */
+template <typename T, typename pars>
+class HasParseInto {
+private:
+    template <typename P>
+    static char test(decltype(std::declval<P&>()(std::declval<const std::string&>(),
+                    std::declval<T&>()))*);
+    template <typename P>
+    static long test(...);
+public:
+    static const bool value = sizeof(test<pars>(0)) == sizeof(char);
+};
+
+template <typename T, typename pars>
+const bool HasParseInto<T, pars>::value;
+
+/**
+ * @brief parse s into t by pars, through the parse-into operator if pars has one,
+ *        so that t keeps its memory
+ * @param [in] std::string s
+ * @param [out] T t
+ * @return void
+ * @exception throw std::exception when called pars()
+**/
+template <typename pars, typename T>
+inline void parse_to(const std::string& s, T& t, std::true_type /*parse into*/) {
+    pars()(s, t);
+}
+
+template <typename pars, typename T>
+inline void parse_to(const std::string& s, T& t, std::false_type /*parse into*/) {
+    t = pars()(s);
+}
+
+template <typename pars, typename T>
+inline void parse_to(const std::string& s, T& t) {
+    parse_to<pars>(s, t, std::integral_constant<bool, HasParseInto<T, pars>::value>());
+}
+
+/**
+ * @brief parse the 'num' of a 'num:item1,item2' column, only decimal digits are allowed
+ * @param [in] std::string s
+ * @param [in] size_t end, position of the count separator
+ * @return size_t
+ * @exception throw std::invalid_argument when num is not a number
+ *            or larger than parse_limits().max_array_count
+**/
+inline size_t parse_count(const std::string& s, std::string::size_type end) {
+    if (end == 0) {
+        throw std::invalid_argument("empty count");
+    }
+    size_t num = 0;
+    for (std::string::size_type i = 0; i < end; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            throw std::invalid_argument("invalid count");
+        }
+        num = num * 10 + (s[i] - '0');
+        if (num > parse_limits().max_array_count) {
+            throw std::invalid_argument("invalid vector size");
+        }
+    }
+    return num;
+}
+
+/**
+ * ItemSplitter walks the items of a 'num:item1,item2' column
+ * the item is copied to a buffer of the calling thread, which is kept for later columns,
+ * so no memory is allocated once the buffer is large enough
+ * Tag tells the buffers of nested arrays apart
+ */
+template <typename Tag, char ItemSep, char CountSep>
+class ItemSplitter {
+public:
+    /**
+     * @param [in] std::string s, the column
+     * @exception throw std::invalid_argument when there is no count separator
+     *            or num is invalid
+    **/
+    explicit ItemSplitter(const std::string& s) : _s(s), _item(buffer()) {
+        std::string::size_type pos = s.find(CountSep);
+        if (pos == std::string::npos) {
+            throw std::invalid_argument("can not find count separator for vector");
+        }
+        _num = parse_count(s, pos);
+        //every item takes at least one char except the last one
+        if (_num > s.size() - pos) {
+            throw std::invalid_argument("invalid vector size");
+        }
+        _begin = pos + 1;
+    };
+
+    size_t num() const {
+        return _num;
+    }
+
+    /**
+     * @brief move to the next item
+     * @return const std::string&
+     * @retval the item
+     * @exception throw std::invalid_argument when there are less than num items
+    **/
+    const std::string& next() {
+        if (_begin > _s.size()) {
+            throw std::invalid_argument("parse vector");
+        }
+        std::string::size_type end = _s.find(ItemSep, _begin);
+        if (end == std::string::npos) {
+            end = _s.size();
+        }
+        _item.assign(_s, _begin, end - _begin);
+        _begin = end + 1;
+        return _item;
+    }
+
+    /**
+     * @brief check all items are read
+     * @exception throw std::invalid_argument when there are more than num items
+    **/
+    void finish() const {
+        if (_begin != _s.size() + 1) {
+            throw std::invalid_argument("parse vector");
+        }
+    }
+
+private:
+    static std::string& buffer() {
+        static thread_local std::string item;
+        return item;
+    }
+
+    const std::string& _s;
+    std::string& _item;
+    size_t _num;
+    std::string::size_type _begin;
+    DISALLOW_COPY_AND_ASSIGN(ItemSplitter);
+};
+
+/**
+ * ArrayParse parses a 'num:item1,item2' column into std::vector<T>
+ * ItemSep and CountSep replace ',' and ':', e.g. when ',' separates the columns
+ * every item is parsed by ElemParse, which may be the parse of a user type
+ * or another ArrayParse with different separators;
+ * when ElemParse can parse into an existing T, the elements of the vector are reused
+ */
+template <typename T, char ItemSep = ',', char CountSep = ':', typename ElemParse = Parse<T> >
+class ArrayParse {
+public:
+    std::vector<T> operator()(const std::string& s) const throw(std::exception) {
+        std::vector<T> t;
+        (*this)(s, t);
+        return t;
+    }
+
+    /**
+     * @brief parse into an existing vector, reuse its capacity
+     * @param [in] std::string s
+     * @param [out] std::vector<T> t, resized to num
+     * @return void
+     * @exception throw std::exception when the format is invalid
+    **/
+    void operator()(const std::string& s, std::vector<T>& t) const throw(std::exception) {
+        ItemSplitter<ArrayParse, ItemSep, CountSep> items(s);
+        parse_items(items, t, std::integral_constant<bool, HasParseInto<T, ElemParse>::value>());
+        items.finish();
+    }
+
+private:
+    template <typename Splitter>
+    static void parse_items(Splitter& items, std::vector<T>& t, std::true_type /*parse into*/) {
+        t.resize(items.num());
+        for (size_t i = 0; i < t.size(); i++) {
+            ElemParse()(items.next(), t[i]);
+        }
+    }
+
+    template <typename Splitter>
+    static void parse_items(Splitter& items, std::vector<T>& t, std::false_type /*parse into*/) {
+        t.clear();
+        t.reserve(items.num());
+        for (size_t i = 0; i < items.num(); i++) {
+            t.push_back(ElemParse()(items.next()));
+        }
+    }
+};
+
+/**
+ * FixedArrayParse parses a 'N:item1,item2' column into std::array<T, N> in place
+ * num must be N, the array lives in the Parser, so no memory is allocated
+ */
+template <typename T, size_t N, char ItemSep = ',', char CountSep = ':',
+         typename ElemParse = Parse<T> >
+class FixedArrayParse {
+public:
+    static_assert(N > 0, "FixedArrayParse needs at least one item");
+
+    std::array<T, N> operator()(const std::string& s) const throw(std::exception) {
+        std::array<T, N> t;
+        (*this)(s, t);
+        return t;
+    }
+
+    /**
+     * @brief parse into an existing array
+     * @param [in] std::string s
+     * @param [out] std::array<T, N> t
+     * @return void
+     * @exception throw std::exception when the format is invalid or num is not N
+    **/
+    void operator()(const std::string& s, std::array<T, N>& t) const throw(std::exception) {
+        ItemSplitter<FixedArrayParse, ItemSep, CountSep> items(s);
+        if (items.num() != N) {
+            throw std::invalid_argument("array size mismatch");
+        }
+        for (size_t i = 0; i < N; i++) {
+            parse_to<ElemParse>(items.next(), t[i]);
+        }
+        items.finish();
+    }
+};
+
+/**
+ * specilize Parse for 'std::array<T, N>'
+ * the column is 'N:item1,item2', use FixedArrayParse for other separators
+ */
+template <typename T, size_t N>
+class Parse<std::array<T, N>> : public FixedArrayParse<T, N> {
 };
 
 /**
  * specilize Parse for 'std::vector<T>'
+ * the column is 'num:item1,item2', use ArrayParse for other separators
  */
 template <typename T>
 class Parse<std::vector<T>> {
@@ -101,25 +483,20 @@ public:
     **/
     template<typename pars = Parse<T>>
     std::vector<T> operator()(const std::string& s) const throw(std::exception) {
-        std::vector<T> t;
-        std::string::size_type pos = s.find(':');
-        if (pos == std::string::npos) {
-            throw std::invalid_argument("can not find ':' for vector");
-        }
-        int num = std::stoi(s.substr(0, pos));
-        std::stringstream ss(s.substr(pos + 1, s.size() - pos - 1));
-        std::string sub_str;
-        for (int i = 0; i < num; i++) {
-            if (ss.eof()) {
-                throw std::invalid_argument("parse vector");
-            }
-            getline(ss,sub_str,',');
-            t.push_back(pars()(sub_str));
-        }
-        if (!ss.eof()) {
-            throw std::invalid_argument("parse vector");
-        }
-        return t;
+        return ArrayParse<T, ',', ':', pars>()(s);
+    }
+
+    /**
+     * @brief parse into an existing vector, reuse its capacity
+     *        will be called by Parser::parse
+     * @param [in] std::string s
+     * @param [out] std::vector<T> t, cleared before parse
+     * @return void
+     * @exception throw std::exception when the format is invalid
+    **/
+    template<typename pars = Parse<T>>
+    void operator()(const std::string& s, std::vector<T>& t) const throw(std::exception) {
+        ArrayParse<T, ',', ':', pars>()(s, t);
     }
 };
 
@@ -140,6 +517,9 @@ public:
  * the second template parameter 'pars' is used to parse a string
  * 'pars' default is Parse<T> for built-in types
  * user should specific 'pars' for user defined type T
+ * 'pars' may provide 'void operator()(const std::string&, T&)' to parse into data(),
+ * then the memory held by data() is reused by every line instead of building a new T;
+ * data() is undefined after a failed parse in this case
  */
 template <typename T, typename pars = Parse<T> >
 class Parser : public ParserBase  {
@@ -157,9 +537,9 @@ public:
     **/
     virtual int parse(const std::string& str) override {
         try {
-            _data = pars()(str);
+            parse_data(str, std::integral_constant<bool, HasParseInto<T, pars>::value>());
         } catch (std::exception& e) {
-            CNOTICE_LOG("parse error:%s", e.what());
+            report_error(PARSE_ERROR_COLUMN, e.what());
             return -1;
         }
         return 0;
@@ -169,27 +549,80 @@ public:
         return _data;
     }
 private:
+    void parse_data(const std::string& str, std::true_type /*parse into*/) {
+        pars()(str, _data);
+    }
+
+    void parse_data(const std::string& str, std::false_type /*parse into*/) {
+        _data = pars()(str);
+    }
+
     T _data;
     DISALLOW_COPY_AND_ASSIGN(Parser);
 };
 
 /**
- *LineParser is used to parse a line
+ * RowVisitor is called for every line parsed successfully
+ * the row is held in place by the Parser objects added to the LineParser,
+ * so visit() should read them directly instead of copying the line
+ */
+class RowVisitor {
+public:
+    virtual void visit() = 0;
+    virtual ~RowVisitor() {};
+};
+
+/**
+ * LineFormat holds the delimiters of a dict as compile-time constants,
+ * every format gets its own split loop, so the tab separated one stays as fast as before
+ * Sep : column separator, Eol : line terminator
+ * Quoted : RFC4180 quoting, a column in '"' may hold Sep and Eol, '""' is a '"' in it
+ */
+template <char Sep, char Eol = '\n', bool Quoted = false>
+struct LineFormat {
+    static const char separator = Sep;
+    static const char eol = Eol;
+    static const bool quoted = Quoted;
+};
+
+template <char Sep, char Eol, bool Quoted>
+const char LineFormat<Sep, Eol, Quoted>::separator;
+template <char Sep, char Eol, bool Quoted>
+const char LineFormat<Sep, Eol, Quoted>::eol;
+template <char Sep, char Eol, bool Quoted>
+const bool LineFormat<Sep, Eol, Quoted>::quoted;
+
+//tab separated, the default format
+typedef LineFormat<'\t'> TsvFormat;
+//'\x01' separated
+typedef LineFormat<'\x01'> CtrlAFormat;
+//comma separated with quoting, the rows may end with "\r\n"
+typedef LineFormat<',', '\n', true> CsvFormat;
+
+/**
+ *BasicLineParser is used to parse a line of the given LineFormat
+ *use LineParser for tab separated lines
  */
-class LineParser {
+template <typename Format>
+class BasicLineParser {
 public:
-    LineParser() {};
+    BasicLineParser() {};
     /**
      * @brief add Parser to parse a column
      * @param [in] ParserBase* p, should be a pointer to a Parser<> object
-     * @return void
-     * @retval
+     * @return int
+     * @retval 0:succeed, -1:more than parse_limits().max_columns columns
      * @see
      * @author zhangfucheng
      * @date 2017.11.7
     **/
-    void add_parser(ParserBase* p) {
+    int add_parser(ParserBase* p) {
+        if (_v.size() >= parse_limits().max_columns) {
+            CWARNING_LOG("too many columns, max_columns:%zu", parse_limits().max_columns);
+            return -1;
+        }
         _v.push_back(p);
+        return 0;
     }
 
     /**
@@ -200,49 +633,144 @@ public:
      * @author zhangfucheng
      * @date 2017.11.7
     **/
-    int parse(std::string line) const {
-        std::stringstream ss(line);
-        std::string sub_str;
+    int parse(const std::string& line) const {
+        if (line.size() > parse_limits().max_line_length) {
+            return -1;
+        }
+        return split(line, std::integral_constant<bool, Format::quoted>());
+    }
+
+private:
+    int split(const std::string& line, std::false_type /*quoted*/) const {
+        std::string::size_type begin = 0;
         unsigned int i = 0;
-        while (getline(ss, sub_str, '\t') && i < _v.size()) {
-            int cons = _v[i]->parse(sub_str);
+        //a separator at the end of line does not start a new column
+        while (begin < line.size()) {
+            if (i >= _v.size()) {
+                return -1;
+            }
+            std::string::size_type end = line.find(Format::separator, begin);
+            if (end == std::string::npos) {
+                end = line.size();
+            }
+            _column.assign(line, begin, end - begin);
+            int cons = _v[i]->parse(_column);
             if (cons < 0) {
                 return -1;
             }
             i++;
+            begin = end + 1;
         }
-        if (ss.eof() && (i == _v.size())) {
+        if (i == _v.size()) {
             return 0;
         }
         return -1;
     }
 
-private:
+    int split(const std::string& line, std::true_type /*quoted*/) const {
+        std::string::size_type begin = 0;
+        unsigned int i = 0;
+        //as RFC4180, every separator starts a new column, "a," has an empty last column
+        while (true) {
+            if (i >= _v.size()) {
+                return -1;
+            }
+            std::string::size_type end = 0;
+            if (begin < line.size() && line[begin] == '"') {
+                if (unquote(line, begin, &end) != 0) {
+                    return -1;
+                }
+            } else {
+                //no quote at the beginning, the column is taken as it is
+                end = line.find(Format::separator, begin);
+                if (end == std::string::npos) {
+                    end = line.size();
+                }
+                _column.assign(line, begin, end - begin);
+            }
+            int cons = _v[i]->parse(_column);
+            if (cons < 0) {
+                return -1;
+            }
+            i++;
+            if (end >= line.size()) {
+                break;
+            }
+            begin = end + 1;
+        }
+        if (i == _v.size()) {
+            return 0;
+        }
+        return -1;
+    }
+
+    /**
+     * @brief copy the quoted column starting at begin to _column without quotes
+     * @param [in] std::string line
+     * @param [in] size_t begin, position of the opening '"'
+     * @param [out] size_t* end, position of the separator after the column or line.size()
+     * @return int
+     * @retval 0:succeed, -1:no closing '"' or chars after it
+    **/
+    int unquote(const std::string& line, std::string::size_type begin,
+            std::string::size_type* end) const {
+        _column.clear();
+        std::string::size_type pos = begin + 1;
+        while (true) {
+            std::string::size_type quote = line.find('"', pos);
+            if (quote == std::string::npos) {
+                return -1;
+            }
+            _column.append(line, pos, quote - pos);
+            pos = quote + 1;
+            if (pos < line.size() && line[pos] == '"') {
+                _column.push_back('"');
+                pos++;
+            } else {
+                break;
+            }
+        }
+        if (pos < line.size() && line[pos] != Format::separator) {
+            return -1;
+        }
+        *end = pos;
+        return 0;
+    }
+
     //should not be shared_ptr, because the element it point to may in stack
     std::vector<ParserBase*> _v;
-    DISALLOW_COPY_AND_ASSIGN(LineParser);
+    //buffer of the current column, reused by every line
+    mutable std::string _column;
+    DISALLOW_COPY_AND_ASSIGN(BasicLineParser);
 };
+
+typedef BasicLineParser<TsvFormat> LineParser;
+
+class LineIndex;
+
 /**
- * DictParser is used to parse a file
- * it parse a line every time
+ * BasicDictParser is used to parse a file of the given LineFormat
+ * it parse a line every time, a quoted column may join several lines to one row
+ * use DictParser for tab separated files
  */
-class DictParser {
+template <typename Format>
+class BasicDictParser {
 public:
-    DictParser(std::string path) : _fs(path) {};
-    ~DictParser() {
+    BasicDictParser(std::string path) : _fs(path) {};
+    ~BasicDictParser() {
         _fs.close();
     }
 
     /**
      * @brief add column
      * @param ParserBase* p, should be a pointer to a Parser<> object
-     * @return void
-     * @retval
+     * @return int
+     * @retval 0:succeed, -1:more than parse_limits().max_columns columns
      * @author zhangfucheng
      * @date 2017.11.7
     **/
-    void add_column(ParserBase* p) {
-        _lp.add_parser(p);
+    int add_column(ParserBase* p) {
+        return _lp.add_parser(p);
     }
 
     /**
@@ -254,9 +782,61 @@ public:
      * @date 2017.11.7
     **/
     int parse_next_line() {
-        std::string line;
-        std::getline(_fs, line);
-        return _lp.parse(line);
+        if (next_line() != 0) {
+            return -1;
+        }
+        return _lp.parse(_line);
+    }
+
+    /**
+     * @brief parse all remaining lines, skip invalid lines
+     * @param [in] RowVisitor* visitor, called after every valid line
+     * @return size_t
+     * @retval number of valid lines
+    **/
+    size_t parse_all(RowVisitor* visitor) {
+        size_t good = 0;
+        int ret = 0;
+        while ((ret = next_line()) <= 0) {
+            if (ret == 0 && _lp.parse(_line) == 0) {
+                visitor->visit();
+                good++;
+            } else {
+                report_error(PARSE_ERROR_LINE, "line format error");
+            }
+        }
+        return good;
+    }
+
+    /**
+     * @brief parse a slice of the remaining lines, skip invalid lines
+     *        call it again to resume from the next line, until is_file_end()
+     *        at least one line is read for every call, so the parse always makes progress
+     * @param [in] RowVisitor* visitor, called after every valid line
+     * @param [in] size_t max_lines, stop after max_lines lines
+     * @param [in] int64_t max_us, stop after max_us microseconds
+     * @return size_t
+     * @retval number of valid lines of this slice
+    **/
+    size_t parse_some(RowVisitor* visitor, size_t max_lines, int64_t max_us) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t good = 0;
+        size_t n = 0;
+        int ret = 0;
+        while ((ret = next_line()) <= 0) {
+            if (ret == 0 && _lp.parse(_line) == 0) {
+                visitor->visit();
+                good++;
+            } else {
+                report_error(PARSE_ERROR_LINE, "line format error");
+            }
+            n++;
+            if (n >= max_lines || std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count() >= max_us) {
+                break;
+            }
+        }
+        return good;
     }
 
     /**
@@ -286,11 +866,85 @@ public:
         _fs.close();
         _fs.open(path);
     }
+
+    /**
+     * @brief move to line n, the next parse starts from line n
+     *        defined in line_index.h, n counts Eol, not rows of quoted columns
+     *        the LineIndex is built on '\n', other Eol are refused
+     * @param [in] const LineIndex& index, built for the file of this DictParser
+     * @param [in] size_t n, line number from 0
+     * @return int
+     * @retval 0:succeed, -1:n is out of range
+    **/
+    int seek_to_line(const LineIndex& index, size_t n);
 private:
+    //read the next row to _line, see read_line
+    int next_line() {
+        size_t max_length = parse_limits().max_line_length;
+        int ret = read_line(_fs, _line, max_length, NULL, Format::eol);
+        if (!Format::quoted || ret != 0) {
+            return ret;
+        }
+        //Eol in a quoted column, join the next line
+        bool open = quote_open(_line, false);
+        while (open) {
+            if (read_line(_fs, _piece, max_length, NULL, Format::eol) != 0
+                    || _line.size() + 1 + _piece.size() > max_length) {
+                return -1;
+            }
+            _line.push_back(Format::eol);
+            _line.append(_piece);
+            open = quote_open(_piece, true);
+        }
+        if (Format::eol == '\n' && !_line.empty() && _line[_line.size() - 1] == '\r') {
+            _line.erase(_line.size() - 1);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief whether a quoted column is still open at the end of a physical line
+     *        as unquote, only a '"' at the beginning of a column opens it,
+     *        other quotes of an unquoted column are plain chars
+     * @param [in] std::string s
+     * @param [in] bool open, s starts inside a quoted column
+     * @return bool
+    **/
+    static bool quote_open(const std::string& s, bool open) {
+        if (!open && s.find('"') == std::string::npos) {
+            return false;
+        }
+        bool column_begin = !open;
+        for (std::string::size_type i = 0; i < s.size(); i++) {
+            if (open) {
+                if (s[i] != '"') {
+                    continue;
+                }
+                if (i + 1 < s.size() && s[i + 1] == '"') {
+                    i++;
+                } else {
+                    open = false;
+                }
+            } else if (s[i] == Format::separator) {
+                column_begin = true;
+            } else {
+                open = column_begin && s[i] == '"';
+                column_begin = false;
+            }
+        }
+        return open;
+    }
+
     std::fstream _fs;
-    LineParser _lp;
-    DISALLOW_COPY_AND_ASSIGN(DictParser);
+    BasicLineParser<Format> _lp;
+    //buffer of the current line, reused by every line
+    std::string _line;
+    //next line of a row with a quoted Eol
+    std::string _piece;
+    DISALLOW_COPY_AND_ASSIGN(BasicDictParser);
 };
 
+typedef BasicDictParser<TsvFormat> DictParser;
+
 }
 #endif // GOODCODER_PARSER_H
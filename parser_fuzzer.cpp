@@ -0,0 +1,184 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// fuzz target for LineParser and DictParser of tab and comma separated formats,
+// any input must not crash
+// libFuzzer : clang++ -std=c++11 -g -fsanitize=fuzzer,address parser_fuzzer.cpp
+// AFL or replay : g++ -std=c++11 -DPARSER_FUZZER_MAIN parser_fuzzer.cpp, then
+//                 ./a.out file... or ./a.out < file
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+#include "flat_map.h"
+
+namespace {
+
+//user defined structure
+struct St {
+    int i;
+    float f;
+};
+
+//user defined class for parse user structure
+class StParse {
+public:
+    St operator()(const std::string& s) const {
+        St temp;
+        std::string::size_type pos = s.find(',');
+        if (pos == std::string::npos) {
+            throw std::invalid_argument("can not find ',' for st");
+        }
+        temp.i = std::stoi(s.substr(0, pos));
+        temp.f = std::stof(s.substr(pos + 1));
+        return temp;
+    }
+};
+
+//every column type of the demo
+struct Columns {
+    baidu::Parser<int> p0;
+    baidu::Parser<float> p1;
+    baidu::Parser<double> p2;
+    baidu::Parser<std::string> p3;
+    baidu::Parser<std::vector<float>> p4;
+    baidu::Parser<std::vector<int>> p5;
+    baidu::Parser<St, StParse> p6;
+
+    template <typename Format>
+    void add_to(baidu::BasicLineParser<Format>* lp) {
+        lp->add_parser(&p0);
+        lp->add_parser(&p1);
+        lp->add_parser(&p2);
+        lp->add_parser(&p3);
+        lp->add_parser(&p4);
+        lp->add_parser(&p5);
+        lp->add_parser(&p6);
+    }
+
+    template <typename Format>
+    void add_to(baidu::BasicDictParser<Format>* dp) {
+        dp->add_column(&p0);
+        dp->add_column(&p1);
+        dp->add_column(&p2);
+        dp->add_column(&p3);
+        dp->add_column(&p4);
+        dp->add_column(&p5);
+        dp->add_column(&p6);
+    }
+};
+
+//nested column types
+struct NestedColumns {
+    baidu::Parser<std::array<float, 3>> p0;
+    baidu::Parser<baidu::FlatMap<int, std::string>> p1;
+    baidu::Parser<std::vector<std::vector<int>>,
+            baidu::ArrayParse<std::vector<int>, ';'> > p2;
+
+    void add_to(baidu::LineParser* lp) {
+        lp->add_parser(&p0);
+        lp->add_parser(&p1);
+        lp->add_parser(&p2);
+    }
+};
+
+//count rows, so the visitor is not optimized away
+class Counter : public baidu::RowVisitor {
+public:
+    Counter() : count(0) {};
+    virtual void visit() override {
+        count++;
+    }
+    size_t count;
+};
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    //small limits keep every run fast, the limit checks are fuzzed as well
+    baidu::parse_limits().max_line_length = 4096;
+    baidu::parse_limits().max_array_count = 256;
+
+    std::string input(reinterpret_cast<const char*>(data), size);
+
+    //LineParser on every line of the input
+    Columns line_columns;
+    baidu::LineParser lp;
+    line_columns.add_to(&lp);
+    Columns csv_columns;
+    baidu::BasicLineParser<baidu::CsvFormat> csv_lp;
+    csv_columns.add_to(&csv_lp);
+    NestedColumns nested_columns;
+    baidu::LineParser nested_lp;
+    nested_columns.add_to(&nested_lp);
+    std::string::size_type begin = 0;
+    while (begin <= input.size()) {
+        std::string::size_type end = input.find('\n', begin);
+        if (end == std::string::npos) {
+            end = input.size();
+        }
+        lp.parse(input.substr(begin, end - begin));
+        csv_lp.parse(input.substr(begin, end - begin));
+        nested_lp.parse(input.substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    //DictParser on the input as a file
+    char path[] = "/tmp/parser_fuzzer_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t written = write(fd, input.data(), input.size());
+    close(fd);
+    if (written == static_cast<ssize_t>(input.size())) {
+        Columns dict_columns;
+        baidu::DictParser dp(path);
+        dict_columns.add_to(&dp);
+        Counter counter;
+        if (!input.empty() && input[0] % 2 == 0) {
+            dp.parse_all(&counter);
+        } else {
+            while (!dp.is_file_end()) {
+                dp.parse_next_line();
+            }
+        }
+        Columns csv_dict_columns;
+        baidu::BasicDictParser<baidu::CsvFormat> csv_dp(path);
+        csv_dict_columns.add_to(&csv_dp);
+        csv_dp.parse_all(&counter);
+    }
+    unlink(path);
+    return 0;
+}
+
+#ifdef PARSER_FUZZER_MAIN
+//run the target on files or stdin, used by AFL and to replay crashes
+int main(int argc, char** argv) {
+    std::vector<std::string> inputs;
+    if (argc < 2) {
+        inputs.push_back(std::string(std::istreambuf_iterator<char>(std::cin),
+                    std::istreambuf_iterator<char>()));
+    }
+    for (int i = 1; i < argc; i++) {
+        std::ifstream fs(argv[i], std::ios::binary);
+        inputs.push_back(std::string(std::istreambuf_iterator<char>(fs),
+                    std::istreambuf_iterator<char>()));
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(inputs[i].data()),
+                inputs[i].size());
+    }
+    return 0;
+}
+#endif
@@ -3,6 +3,12 @@
 //
 // call gtest to test parser
 
+#include <stdio.h>
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 
@@ -15,6 +21,16 @@ namespace test {
 using baidu::Parser;
 using baidu::LineParser;
 using baidu::DictParser;
+using baidu::ParseLimits;
+using baidu::parse_limits;
+using baidu::read_line;
+using baidu::ArrayParse;
+using baidu::FixedArrayParse;
+using baidu::BasicLineParser;
+using baidu::BasicDictParser;
+using baidu::CtrlAFormat;
+using baidu::CsvFormat;
+using baidu::LineFormat;
 
 // test LineParser, for only int
 TEST(LineParser, int) {
@@ -290,6 +306,310 @@ TEST(DictParser, file) {
     EXPECT_TRUE(dp.is_file_end());
 }
 
+//restore the default limits when a test ends
+class LimitsGuard {
+public:
+    LimitsGuard() : _saved(parse_limits()) {};
+    ~LimitsGuard() {
+        parse_limits() = _saved;
+    }
+private:
+    ParseLimits _saved;
+};
+
+//test the count of vector is checked before parsing items
+TEST(Limits, array_count) {
+    LimitsGuard guard;
+    Parser<std::vector<int>> p0;
+    Parser<std::vector<std::string>> p1;
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+
+    EXPECT_EQ(lp.parse("3:1,2,3\t3:,,"), 0);
+    ASSERT_EQ(p1.data().size(), 3);
+    EXPECT_STREQ(p1.data()[2].c_str(), "");
+    EXPECT_EQ(lp.parse("2000000000:1\t1:a"), -1);
+    EXPECT_EQ(lp.parse("99999999999999999999:1\t1:a"), -1);
+    EXPECT_EQ(lp.parse("-1:\t1:a"), -1);
+    EXPECT_EQ(lp.parse("4:1,2,3\t1:a"), -1);
+    EXPECT_EQ(lp.parse("0:\t1:a"), -1);
+
+    parse_limits().max_array_count = 2;
+    EXPECT_EQ(lp.parse("2:1,2\t1:a"), 0);
+    EXPECT_EQ(lp.parse("3:1,2,3\t1:a"), -1);
+}
+
+//test lines and columns longer than limits
+TEST(Limits, line_and_columns) {
+    LimitsGuard guard;
+    parse_limits().max_line_length = 16;
+    parse_limits().max_columns = 2;
+    Parser<std::string> p0;
+    Parser<std::string> p1;
+    Parser<std::string> p2;
+    LineParser lp;
+    EXPECT_EQ(lp.add_parser(&p0), 0);
+    EXPECT_EQ(lp.add_parser(&p1), 0);
+    EXPECT_EQ(lp.add_parser(&p2), -1);
+
+    EXPECT_EQ(lp.parse("0123456\t0123456"), 0);
+    EXPECT_EQ(lp.parse("0123456\t012345678"), -1);
+}
+
+//test read_line drops long lines but keeps the following lines
+TEST(Limits, read_line) {
+    std::string long_line(10000, 'x');
+    std::stringstream ss("abc\n" + long_line + "\n\n" + long_line + "\nend");
+    std::string line;
+    size_t consumed = 0;
+    EXPECT_EQ(read_line(ss, line, 100, &consumed), 0);
+    EXPECT_STREQ(line.c_str(), "abc");
+    EXPECT_EQ(consumed, 4);
+    EXPECT_EQ(read_line(ss, line, 100, &consumed), -1);
+    EXPECT_TRUE(line.empty());
+    EXPECT_EQ(consumed, 10001);
+    EXPECT_EQ(read_line(ss, line, 100, &consumed), 0);
+    EXPECT_TRUE(line.empty());
+    EXPECT_EQ(consumed, 1);
+    EXPECT_EQ(read_line(ss, line, 10000, &consumed), 0);
+    EXPECT_EQ(line, long_line);
+    EXPECT_EQ(read_line(ss, line, 100, &consumed), 0);
+    EXPECT_STREQ(line.c_str(), "end");
+    EXPECT_EQ(consumed, 3);
+    EXPECT_EQ(read_line(ss, line, 100, &consumed), 1);
+    EXPECT_EQ(consumed, 0);
+}
+
+//test DictParser skips a long line without storing it
+TEST(Limits, dict_long_line) {
+    LimitsGuard guard;
+    parse_limits().max_line_length = 1024;
+    const char* path = "long_line.txt";
+    std::ofstream out(path);
+    out << "1\tabc\n" << std::string(1 << 20, '2') << "\tabc\n3\tabc\n";
+    out.close();
+
+    Parser<int> p0;
+    Parser<std::string> p1;
+    DictParser dp(path);
+    dp.add_column(&p0);
+    dp.add_column(&p1);
+    EXPECT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 1);
+    EXPECT_EQ(dp.parse_next_line(), -1);
+    EXPECT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 3);
+    remove(path);
+}
+
+//worst-case-time regression: garbage rows must be rejected quickly
+TEST(Limits, worst_case_time) {
+    Parser<int> p0;
+    Parser<double> p1;
+    Parser<std::vector<int>> p2;
+    Parser<std::string> p3;
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+    lp.add_parser(&p2);
+    lp.add_parser(&p3);
+
+    std::vector<std::string> rows;
+    rows.push_back("1\t1.0\t2000000000:1\ta");
+    rows.push_back("1\t1.0\t2147483647:" + std::string(100000, ',') + "\ta");
+    rows.push_back("1\t1.0\t100000:" + std::string(100000, ',') + "\ta");
+    rows.push_back(std::string(1000000, '\t'));
+    rows.push_back(std::string(100000, '9') + "\t1.0\t1:1\ta");
+    rows.push_back("1\t" + std::string(100000, '9') + "e99999999\t1:1\ta");
+    rows.push_back("1\t1.0\t" + std::string(100000, '1') + ":1\ta");
+    rows.push_back(std::string(1000000, ':'));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 10; round++) {
+        for (size_t i = 0; i < rows.size(); i++) {
+            EXPECT_EQ(lp.parse(rows[i]), -1) << "row " << i;
+        }
+    }
+    int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    EXPECT_LT(ms, 2000);
+}
+
+
+//test ArrayParse with other separators
+TEST(ArrayParse, separators) {
+    Parser<std::vector<int>, ArrayParse<int, ';'> > p0;
+    Parser<std::vector<std::string>, ArrayParse<std::string, ' ', '='> > p1;
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+
+    EXPECT_EQ(lp.parse("3:1;2;3\t2=a b"), 0);
+    ASSERT_EQ(p0.data().size(), 3);
+    EXPECT_EQ(p0.data()[2], 3);
+    ASSERT_EQ(p1.data().size(), 2);
+    EXPECT_STREQ(p1.data()[1].c_str(), "b");
+
+    EXPECT_EQ(lp.parse("2:1,2\t1=a"), -1);
+    EXPECT_EQ(lp.parse("1:1\t1:a"), -1);
+}
+
+//test arrays of user types and nested arrays
+TEST(ArrayParse, nested) {
+    //items of St hold ',', so they are separated by ';'
+    Parser<std::vector<St>, ArrayParse<St, ';', ':', Par> > p0;
+    Parser<std::vector<std::vector<int>>, ArrayParse<std::vector<int>, ';'> > p1;
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+
+    EXPECT_EQ(lp.parse("2:1,1.5;2,2.5\t3:2:1,2;1:3;3:4,5,6"), 0);
+    ASSERT_EQ(p0.data().size(), 2);
+    EXPECT_EQ(p0.data()[1].i, 2);
+    EXPECT_FLOAT_EQ(p0.data()[1].f, 2.5);
+    ASSERT_EQ(p1.data().size(), 3);
+    ASSERT_EQ(p1.data()[2].size(), 3);
+    EXPECT_EQ(p1.data()[2][2], 6);
+
+    //inner vectors are parsed in place and keep their capacity
+    const int* inner = p1.data()[2].data();
+    EXPECT_EQ(lp.parse("1:3,3.5\t3:1:7;1:8;2:9,10"), 0);
+    ASSERT_EQ(p1.data()[2].size(), 2);
+    EXPECT_EQ(p1.data()[2][1], 10);
+    EXPECT_EQ(p1.data()[2].data(), inner);
+
+    EXPECT_EQ(lp.parse("1:3\t1:1:1"), -1);
+    EXPECT_EQ(lp.parse("1:3,3.5\t2:1:1"), -1);
+    EXPECT_EQ(lp.parse("1:3,3.5\t1:2:1"), -1);
+    EXPECT_EQ(lp.parse(" 1:3,3.5\t1:1:1"), -1);
+}
+
+//test fixed size arrays
+TEST(FixedArrayParse, array) {
+    Parser<std::array<float, 4>> p0;
+    Parser<std::array<std::string, 2>, FixedArrayParse<std::string, 2, '|'> > p1;
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+
+    EXPECT_EQ(lp.parse("4:0.5,1,1.5,2\t2:ab|cd"), 0);
+    EXPECT_FLOAT_EQ(p0.data()[0], 0.5);
+    EXPECT_FLOAT_EQ(p0.data()[3], 2);
+    EXPECT_STREQ(p1.data()[1].c_str(), "cd");
+
+    //num must be the size of the array
+    EXPECT_EQ(lp.parse("3:0.5,1,1.5\t2:ab|cd"), -1);
+    EXPECT_EQ(lp.parse("5:0.5,1,1.5,2,3\t2:ab|cd"), -1);
+    EXPECT_EQ(lp.parse("4:0.5,1,1.5\t2:ab|cd"), -1);
+    EXPECT_EQ(lp.parse("4:0.5,1,1.5,2,3\t2:ab|cd"), -1);
+    EXPECT_EQ(lp.parse("4:0.5,x,1.5,2\t2:ab|cd"), -1);
+    EXPECT_EQ(lp.parse("4:0.5,1,1.5,2\t2:ab,cd"), -1);
+}
+
+//test '\x01' separated lines
+TEST(LineFormat, ctrl_a) {
+    Parser<int> p0;
+    Parser<std::string> p1;
+    BasicLineParser<CtrlAFormat> lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+
+    EXPECT_EQ(lp.parse("12\x01" "a\tb"), 0);
+    EXPECT_EQ(p0.data(), 12);
+    EXPECT_STREQ(p1.data().c_str(), "a\tb");
+    EXPECT_EQ(lp.parse("12\ta"), -1);
+    EXPECT_EQ(lp.parse("12\x01" "a\x01" "b"), -1);
+
+    //'|' separated, ';' terminated
+    BasicLineParser<LineFormat<'|', ';'> > lp1;
+    lp1.add_parser(&p0);
+    lp1.add_parser(&p1);
+    EXPECT_EQ(lp1.parse("7|x"), 0);
+    EXPECT_EQ(p0.data(), 7);
+}
+
+//test comma separated lines with quoting
+TEST(LineFormat, csv_line) {
+    Parser<int> p0;
+    Parser<std::string> p1;
+    Parser<std::vector<int>> p2;
+    BasicLineParser<CsvFormat> lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+    lp.add_parser(&p2);
+
+    EXPECT_EQ(lp.parse("1,abc,\"2:3,4\""), 0);
+    EXPECT_EQ(p0.data(), 1);
+    EXPECT_STREQ(p1.data().c_str(), "abc");
+    ASSERT_EQ(p2.data().size(), 2);
+    EXPECT_EQ(p2.data()[1], 4);
+
+    EXPECT_EQ(lp.parse("\"2\",\"say \"\"hi\"\", \n bye\",1:5"), 0);
+    EXPECT_EQ(p0.data(), 2);
+    EXPECT_STREQ(p1.data().c_str(), "say \"hi\", \n bye");
+    EXPECT_EQ(p2.data().size(), 1);
+
+    //empty columns
+    EXPECT_EQ(lp.parse("3,,1:5"), 0);
+    EXPECT_STREQ(p1.data().c_str(), "");
+    EXPECT_EQ(lp.parse("3,\"\",1:5"), 0);
+    EXPECT_STREQ(p1.data().c_str(), "");
+
+    //unquoted vector column is split by ','
+    EXPECT_EQ(lp.parse("1,abc,2:3,4"), -1);
+    //no closing quote, chars after closing quote
+    EXPECT_EQ(lp.parse("1,\"abc,1:5"), -1);
+    EXPECT_EQ(lp.parse("1,\"abc\"d,1:5"), -1);
+    //a trailing comma starts a new column
+    EXPECT_EQ(lp.parse("1,abc,1:5,"), -1);
+    EXPECT_EQ(lp.parse("1,abc"), -1);
+}
+
+//test comma separated file with quoted line breaks and "\r\n"
+TEST(LineFormat, csv_dict) {
+    const char* path = "format.csv";
+    std::ofstream out(path, std::ios::binary);
+    out << "1,a\r\n";
+    out << "2,\"b\nc\"\r\n";
+    out << "3,\"d\n\n\"\"e\"\"\"\n";
+    //a quote inside an unquoted column is a plain char, it does not join lines
+    out << "y\" screen,h\n";
+    out << "7,5\" screen\n";
+    out << "8,i\n";
+    out << "x,f\n";
+    out << "4,\"never closed\n";
+    out << "5,g\n";
+    out.close();
+
+    Parser<int> p0;
+    Parser<std::string> p1;
+    BasicDictParser<CsvFormat> dp(path);
+    dp.add_column(&p0);
+    dp.add_column(&p1);
+    EXPECT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 1);
+    EXPECT_STREQ(p1.data().c_str(), "a");
+    EXPECT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 2);
+    EXPECT_STREQ(p1.data().c_str(), "b\nc");
+    EXPECT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 3);
+    EXPECT_STREQ(p1.data().c_str(), "d\n\n\"e\"");
+    EXPECT_EQ(dp.parse_next_line(), -1);
+    EXPECT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 7);
+    EXPECT_STREQ(p1.data().c_str(), "5\" screen");
+    EXPECT_EQ(dp.parse_next_line(), 0);
+    EXPECT_EQ(p0.data(), 8);
+    EXPECT_EQ(dp.parse_next_line(), -1);
+    //the open quote takes the rest of the file
+    EXPECT_EQ(dp.parse_next_line(), -1);
+    EXPECT_EQ(dp.parse_next_line(), -1);
+    EXPECT_TRUE(dp.is_file_end());
+    remove(path);
+}
+
 }
 
 int main(int argc, char** argv) {
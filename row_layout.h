@@ -0,0 +1,452 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// PackedTable keeps the rows of a dict row-major, in records packed by a layout built at compile time
+
+#ifndef GOODCODER_ROW_LAYOUT_H
+#define GOODCODER_ROW_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "parser.h"
+#include "aggregator.h"
+#include "huge_page.h"
+
+namespace baidu {
+
+//a var-length field in a record, its elements are in the side arena of the table
+struct VarRef {
+    //byte offset in the side arena
+    uint32_t offset;
+    //number of elements
+    uint32_t size;
+};
+
+/**
+ * ArrayRef is a read-only view of a var-length field, valid until the table is changed
+ * a string field is an ArrayRef<char>, str() copies it out
+ */
+template <typename T>
+class ArrayRef {
+public:
+    ArrayRef(const T* data, size_t size) : _data(data), _size(size) {};
+
+    const T* data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    const T& operator[](size_t i) const {
+        return _data[i];
+    }
+
+    const T* begin() const {
+        return _data;
+    }
+
+    const T* end() const {
+        return _data + _size;
+    }
+
+    std::basic_string<T> str() const {
+        return std::basic_string<T>(_data, _size);
+    }
+
+private:
+    const T* _data;
+    size_t _size;
+};
+
+/**
+ * FieldTraits tells how a column type is kept in a record
+ * a trivial type, such as int, float, a dict code or std::array<float, 4>, is kept in the record;
+ * std::string and std::vector are kept in the side arena, the record holds a VarRef
+ */
+template <typename T>
+struct FieldTraits {
+    static_assert(std::is_trivial<T>::value, "a fixed-width field must be a trivial type");
+    typedef std::false_type var_length;
+    typedef T stored_type;
+    typedef T view_type;
+};
+
+template <>
+struct FieldTraits<std::string> {
+    typedef std::true_type var_length;
+    typedef VarRef stored_type;
+    typedef char element_type;
+    typedef ArrayRef<char> view_type;
+};
+
+template <typename T, typename A>
+struct FieldTraits<std::vector<T, A> > {
+    static_assert(std::is_trivial<T>::value, "elements of a var-length field must be trivial");
+    typedef std::true_type var_length;
+    typedef VarRef stored_type;
+    typedef T element_type;
+    typedef ArrayRef<T> view_type;
+};
+
+/**
+ * PackedOffset sums the sizes of the fields placed before a field of alignment Align,
+ * the I-th field of the schema; S... are the stored types from the J-th field
+ * fields are placed by alignment from large to small, then in schema order,
+ * so every field is aligned without any padding between fields
+ */
+template <size_t Align, size_t I, size_t J, typename... S>
+struct PackedOffset {
+    static const size_t value = 0;
+};
+
+template <size_t Align, size_t I, size_t J, typename H, typename... S>
+struct PackedOffset<Align, I, J, H, S...> {
+    static const size_t value =
+            ((alignof(H) > Align || (alignof(H) == Align && J < I)) ? sizeof(H) : 0) +
+            PackedOffset<Align, I, J + 1, S...>::value;
+};
+
+//sum of sizeof and max of alignof of S...
+template <typename... S>
+struct PackedSize {
+    static const size_t size = 0;
+    static const size_t align = 1;
+};
+
+template <typename H, typename... S>
+struct PackedSize<H, S...> {
+    static const size_t size = sizeof(H) + PackedSize<S...>::size;
+    static const size_t align =
+            alignof(H) > PackedSize<S...>::align ? alignof(H) : PackedSize<S...>::align;
+};
+
+//the smallest power of 2 not less than n
+constexpr size_t next_pow2(size_t n, size_t p = 1) {
+    return p >= n ? p : next_pow2(n, p * 2);
+}
+
+/**
+ * RowLayout is the record of a schema, Fields... are the column types
+ * offset<I>::value is the byte offset of the I-th field in a record
+ * size is the packed record, stride is the distance between two records in a table:
+ * a record of up to CACHE_LINE_SIZE bytes gets a power of 2 stride, so it never spans two
+ * cache lines; a larger one starts at a cache line
+ */
+template <typename... Fields>
+struct RowLayout {
+    static_assert(sizeof...(Fields) > 0, "a row needs a field at least");
+
+    template <size_t I>
+    struct field {
+        typedef typename std::tuple_element<I, std::tuple<Fields...> >::type type;
+        typedef FieldTraits<type> traits;
+        typedef typename traits::stored_type stored_type;
+    };
+
+    template <size_t I>
+    struct offset {
+        static const size_t value = PackedOffset<alignof(typename field<I>::stored_type), I, 0,
+                typename FieldTraits<Fields>::stored_type...>::value;
+    };
+
+    static const size_t field_num = sizeof...(Fields);
+    static const size_t align = PackedSize<typename FieldTraits<Fields>::stored_type...>::align;
+    static const size_t size =
+            (PackedSize<typename FieldTraits<Fields>::stored_type...>::size + align - 1) /
+            align * align;
+
+    static const size_t stride = size <= CACHE_LINE_SIZE ? next_pow2(size) :
+            (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+};
+
+template <typename... Fields>
+template <size_t I>
+const size_t RowLayout<Fields...>::offset<I>::value;
+template <typename... Fields>
+const size_t RowLayout<Fields...>::field_num;
+template <typename... Fields>
+const size_t RowLayout<Fields...>::align;
+template <typename... Fields>
+const size_t RowLayout<Fields...>::size;
+template <typename... Fields>
+const size_t RowLayout<Fields...>::stride;
+
+//0, 1, ..., N - 1 as a type, to expand a tuple
+template <size_t... I>
+struct IndexList {
+};
+
+template <size_t N, size_t... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {
+};
+
+template <size_t... I>
+struct MakeIndexList<0, I...> {
+    typedef IndexList<I...> type;
+};
+
+/**
+ * PackedTable keeps rows of Fields... one record after another, in the layout of RowLayout
+ * a point lookup of all fixed-width fields of a row reads one record, one cache line when
+ * the record is not larger than a cache line; var-length fields add a read of the side arena
+ * records and the side arena are both allocated by HugePageAllocator,
+ * var-length fields are referred by 32 bit offsets, so the side arena holds up to 4GB
+ * usage:
+ *   PackedTable<int, float, std::string> table;
+ *   table.append(1, 0.5f, std::string("abc"));
+ *   float f = table.get<1>(0);
+ *   std::string s = table.get<2>(0).str();
+ */
+template <typename... Fields>
+class PackedTable {
+public:
+    typedef RowLayout<Fields...> layout;
+
+    template <size_t I>
+    struct view {
+        typedef typename layout::template field<I>::traits::view_type type;
+    };
+
+    explicit PackedTable(HugePageMode mode = HUGE_PAGE_TRANSPARENT) :
+            _records(HugePageAllocator<char>(mode)), _arena(HugePageAllocator<char>(mode)),
+            _size(0) {};
+
+    /**
+     * @brief append a row
+     * @param [in] Fields... values
+     * @return int
+     * @retval 0:succeed, -1:the side arena is full, the table is not changed
+    **/
+    int append(const Fields&... values) {
+        size_t arena_size = _arena.size();
+        _records.resize(_records.size() + layout::stride);
+        if (store<0>(&_records[_size * layout::stride], values...) != 0) {
+            _records.resize(_size * layout::stride);
+            _arena.resize(arena_size);
+            return -1;
+        }
+        _size++;
+        return 0;
+    }
+
+    /**
+     * @brief append all rows of another table, or of this table itself
+     * @param [in] PackedTable other
+     * @return int
+     * @retval 0:succeed, -1:the side arena is full, the table is not changed
+    **/
+    int append_table(const PackedTable& other) {
+        //every var-length element is aligned to its own size in the side arena of other
+        size_t base = round_up(_arena.size(), CACHE_LINE_SIZE);
+        if (base + other._arena.size() > UINT32_MAX) {
+            return -1;
+        }
+        //other may be this table, take its sizes before growing, and copy after
+        //growing from the new buffers, where its rows are still at the front
+        size_t arena_bytes = other._arena.size();
+        size_t record_bytes = other._records.size();
+        size_t rows = other._size;
+        _arena.resize(base + arena_bytes);
+        if (arena_bytes > 0) {
+            memcpy(&_arena[base], &other._arena[0], arena_bytes);
+        }
+        size_t first = _records.size();
+        _records.resize(first + record_bytes);
+        if (record_bytes > 0) {
+            memcpy(&_records[first], &other._records[0], record_bytes);
+        }
+        for (size_t i = 0; i < rows; i++) {
+            rebase<0>(&_records[first + i * layout::stride], static_cast<uint32_t>(base));
+        }
+        _size += rows;
+        return 0;
+    }
+
+    /**
+     * @brief get a field of a row
+     * @param [in] size_t row, less than size()
+     * @return the value of a fixed-width field, an ArrayRef of a var-length field
+    **/
+    template <size_t I>
+    typename view<I>::type get(size_t row) const {
+        typedef typename layout::template field<I> F;
+        return load<typename F::type>(record(row) + layout::template offset<I>::value,
+                typename F::traits::var_length());
+    }
+
+    //the record of a row, for prefetching
+    const char* record(size_t row) const {
+        return &_records[row * layout::stride];
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    //bytes of the side arena
+    size_t arena_bytes() const {
+        return _arena.size();
+    }
+
+    /**
+     * @brief reserve memory before a bulk load
+     * @param [in] size_t rows
+     * @param [in] size_t arena_bytes, bytes of all var-length fields
+     * @return void
+    **/
+    void reserve(size_t rows, size_t arena_bytes = 0) {
+        _records.reserve(rows * layout::stride);
+        _arena.reserve(arena_bytes);
+    }
+
+    void clear() {
+        _records.clear();
+        _arena.clear();
+        _size = 0;
+    }
+
+private:
+    typedef std::vector<char, HugePageAllocator<char> > Buffer;
+
+    template <size_t I>
+    int store(char* /*record*/) {
+        return 0;
+    }
+
+    template <size_t I, typename H, typename... T>
+    int store(char* record, const H& value, const T&... rest) {
+        if (store_field(record + layout::template offset<I>::value, value,
+                typename FieldTraits<H>::var_length()) != 0) {
+            return -1;
+        }
+        return store<I + 1>(record, rest...);
+    }
+
+    template <typename T>
+    int store_field(char* slot, const T& value, std::false_type) {
+        memcpy(slot, &value, sizeof(T));
+        return 0;
+    }
+
+    template <typename T>
+    int store_field(char* slot, const T& value, std::true_type) {
+        typedef typename FieldTraits<T>::element_type E;
+        size_t offset = round_up(_arena.size(), alignof(E));
+        size_t bytes = value.size() * sizeof(E);
+        if (offset + bytes > UINT32_MAX) {
+            return -1;
+        }
+        _arena.resize(offset + bytes);
+        if (bytes != 0) {
+            memcpy(&_arena[offset], value.data(), bytes);
+        }
+        VarRef ref;
+        ref.offset = static_cast<uint32_t>(offset);
+        ref.size = static_cast<uint32_t>(value.size());
+        memcpy(slot, &ref, sizeof(ref));
+        return 0;
+    }
+
+    template <typename T>
+    T load(const char* slot, std::false_type) const {
+        T value;
+        memcpy(&value, slot, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    typename FieldTraits<T>::view_type load(const char* slot, std::true_type) const {
+        typedef typename FieldTraits<T>::element_type E;
+        VarRef ref;
+        memcpy(&ref, slot, sizeof(ref));
+        return typename FieldTraits<T>::view_type(
+                reinterpret_cast<const E*>(_arena.data() + ref.offset), ref.size);
+    }
+
+    //move the VarRef of every var-length field of a record by base
+    template <size_t I>
+    typename std::enable_if<I == sizeof...(Fields)>::type rebase(char* /*record*/,
+            uint32_t /*base*/) {
+    }
+
+    template <size_t I>
+    typename std::enable_if<(I < sizeof...(Fields))>::type rebase(char* record, uint32_t base) {
+        rebase_field(record + layout::template offset<I>::value, base,
+                typename layout::template field<I>::traits::var_length());
+        rebase<I + 1>(record, base);
+    }
+
+    void rebase_field(char* /*slot*/, uint32_t /*base*/, std::false_type) {
+    }
+
+    void rebase_field(char* slot, uint32_t base, std::true_type) {
+        VarRef ref;
+        memcpy(&ref, slot, sizeof(ref));
+        ref.offset += base;
+        memcpy(slot, &ref, sizeof(ref));
+    }
+
+    //records of all rows, layout::stride bytes each
+    Buffer _records;
+    //elements of var-length fields
+    Buffer _arena;
+    size_t _size;
+    DISALLOW_COPY_AND_ASSIGN(PackedTable);
+};
+
+/**
+ * RowCollector appends the columns of every row to a PackedTable, one record a row
+ * it is the row-major choice of a bulk load, ColumnCollector is the column-major one:
+ * use it when all fields of a row are read together, such as lookups by key
+ * P... are the column parsers, the fields are their ColumnType
+ * merge() appends the rows of another worker, in worker order
+ */
+template <typename... P>
+class RowCollector : public RowVisitor {
+public:
+    typedef PackedTable<typename ColumnType<P>::type...> table_type;
+
+    explicit RowCollector(P*... columns) : _columns(columns...) {};
+
+    virtual void visit() override {
+        if (append(typename MakeIndexList<sizeof...(P)>::type()) != 0) {
+            report_error(PARSE_ERROR_LINE, "side arena of the row table is full");
+        }
+    }
+
+    void merge(const RowCollector& other) {
+        if (_table.append_table(other._table) != 0) {
+            report_error(PARSE_ERROR_LINE, "side arena of the row table is full");
+        }
+    }
+
+    table_type& table() {
+        return _table;
+    }
+
+private:
+    template <size_t... I>
+    int append(IndexList<I...>) {
+        return _table.append(std::get<I>(_columns)->data()...);
+    }
+
+    std::tuple<P*...> _columns;
+    table_type _table;
+    DISALLOW_COPY_AND_ASSIGN(RowCollector);
+};
+
+}
+#endif // GOODCODER_ROW_LAYOUT_H
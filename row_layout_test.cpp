@@ -0,0 +1,178 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test RowLayout, PackedTable and RowCollector
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "row_layout.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::DictParser;
+using baidu::RowLayout;
+using baidu::PackedTable;
+using baidu::RowCollector;
+using baidu::ArrayRef;
+using baidu::CACHE_LINE_SIZE;
+
+//test the layout built at compile time
+TEST(RowLayout, offsets) {
+    //double first, then the 4 byte aligned int and string ref, then short and char
+    typedef RowLayout<char, double, int, short, std::string> Layout;
+    EXPECT_EQ(Layout::offset<1>::value, 0);
+    EXPECT_EQ(Layout::offset<2>::value, 8);
+    EXPECT_EQ(Layout::offset<4>::value, 12);
+    EXPECT_EQ(Layout::offset<3>::value, 20);
+    EXPECT_EQ(Layout::offset<0>::value, 22);
+    EXPECT_EQ(Layout::align, 8);
+    EXPECT_EQ(Layout::size, 24);
+    EXPECT_EQ(Layout::stride, 32);
+
+    typedef RowLayout<int, float, uint32_t> Small;
+    static_assert(Small::size == 12 && Small::stride == 16, "3 fields of 4 bytes");
+    typedef RowLayout<std::array<double, 9>, char> Large;
+    EXPECT_EQ(Large::size, 80);
+    EXPECT_EQ(Large::stride, 2 * CACHE_LINE_SIZE);
+}
+
+//test appending and reading rows
+TEST(PackedTable, append) {
+    PackedTable<int, std::string, float, std::vector<double>, char> table;
+    std::vector<double> values;
+    for (int i = 0; i < 1000; i++) {
+        std::ostringstream os;
+        os << "row" << i;
+        std::string s = (i % 10 == 0) ? std::string() : os.str();
+        ASSERT_EQ(table.append(i, s, i * 0.5f, values, static_cast<char>('a' + i % 26)), 0);
+        values.push_back(i);
+        if (values.size() > 5) {
+            values.clear();
+        }
+    }
+    ASSERT_EQ(table.size(), 1000);
+    EXPECT_EQ(decltype(table)::layout::stride, 32);
+    values.clear();
+    for (int i = 0; i < 1000; i++) {
+        //a record never spans two cache lines
+        uintptr_t addr = reinterpret_cast<uintptr_t>(table.record(i));
+        EXPECT_EQ(addr % CACHE_LINE_SIZE / 32, (addr + 31) % CACHE_LINE_SIZE / 32);
+        EXPECT_EQ(table.get<0>(i), i);
+        EXPECT_EQ(table.get<1>(i).empty(), i % 10 == 0);
+        if (i % 10 != 0) {
+            std::ostringstream os;
+            os << "row" << i;
+            EXPECT_EQ(table.get<1>(i).str(), os.str());
+        }
+        EXPECT_EQ(table.get<2>(i), i * 0.5f);
+        ArrayRef<double> v = table.get<3>(i);
+        ASSERT_EQ(v.size(), values.size());
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(v.data()) % alignof(double), 0);
+        for (size_t j = 0; j < v.size(); j++) {
+            EXPECT_EQ(v[j], values[j]);
+        }
+        EXPECT_EQ(table.get<4>(i), 'a' + i % 26);
+        values.push_back(i);
+        if (values.size() > 5) {
+            values.clear();
+        }
+    }
+
+    PackedTable<int, std::string, float, std::vector<double>, char> other;
+    ASSERT_EQ(other.append(-1, std::string("other"), 1.5f, std::vector<double>(3, 2.5), 'z'), 0);
+    ASSERT_EQ(table.append_table(other), 0);
+    ASSERT_EQ(table.size(), 1001);
+    EXPECT_EQ(table.get<0>(1000), -1);
+    EXPECT_EQ(table.get<1>(1000).str(), "other");
+    ASSERT_EQ(table.get<3>(1000).size(), 3);
+    EXPECT_EQ(table.get<3>(1000)[2], 2.5);
+    EXPECT_EQ(table.get<1>(999).str(), "row999");
+
+    //append a table to itself
+    ASSERT_EQ(other.append(-2, std::string("second"), 2.5f, std::vector<double>(2, 3.5), 'y'), 0);
+    ASSERT_EQ(other.append_table(other), 0);
+    ASSERT_EQ(other.append_table(other), 0);
+    ASSERT_EQ(other.size(), 8);
+    for (size_t i = 0; i < other.size(); i++) {
+        EXPECT_EQ(other.get<0>(i), i % 2 == 0 ? -1 : -2);
+        EXPECT_EQ(other.get<1>(i).str(), i % 2 == 0 ? "other" : "second");
+        ASSERT_EQ(other.get<3>(i).size(), i % 2 == 0 ? 3 : 2);
+        EXPECT_EQ(other.get<3>(i)[1], i % 2 == 0 ? 2.5 : 3.5);
+        EXPECT_EQ(other.get<4>(i), i % 2 == 0 ? 'z' : 'y');
+    }
+
+    table.clear();
+    EXPECT_EQ(table.size(), 0);
+    EXPECT_EQ(table.arena_bytes(), 0);
+}
+
+//test the row-major bulk load of a dict, and merging the tables of workers
+TEST(RowCollector, parse_all) {
+    const char* path = "row_layout.txt";
+    std::ofstream out(path);
+    for (int i = 0; i < 100; i++) {
+        if (i % 10 == 3) {
+            out << "bad\tline\n";
+        } else {
+            out << i << "\tkey" << i << "\t2:" << i << "," << i + 1 << "\t" << i * 0.25 << "\n";
+        }
+    }
+    out.close();
+
+    Parser<int> p0;
+    Parser<std::string> p1;
+    Parser<std::vector<int>> p2;
+    Parser<double> p3;
+    DictParser dp(path);
+    dp.add_column(&p0);
+    dp.add_column(&p1);
+    dp.add_column(&p2);
+    dp.add_column(&p3);
+    RowCollector<Parser<int>, Parser<std::string>, Parser<std::vector<int>>, Parser<double>>
+            rows(&p0, &p1, &p2, &p3);
+    EXPECT_EQ(dp.parse_all(&rows), 90);
+
+    PackedTable<int, std::string, std::vector<int>, double>& table = rows.table();
+    ASSERT_EQ(table.size(), 90);
+    size_t row = 0;
+    for (int i = 0; i < 100; i++) {
+        if (i % 10 == 3) {
+            continue;
+        }
+        std::ostringstream key;
+        key << "key" << i;
+        EXPECT_EQ(table.get<0>(row), i);
+        EXPECT_EQ(table.get<1>(row).str(), key.str());
+        ASSERT_EQ(table.get<2>(row).size(), 2);
+        EXPECT_EQ(table.get<2>(row)[1], i + 1);
+        EXPECT_EQ(table.get<3>(row), i * 0.25);
+        row++;
+    }
+
+    RowCollector<Parser<int>, Parser<std::string>, Parser<std::vector<int>>, Parser<double>>
+            all(&p0, &p1, &p2, &p3);
+    all.merge(rows);
+    all.merge(rows);
+    ASSERT_EQ(all.table().size(), 180);
+    EXPECT_EQ(all.table().get<1>(90).str(), "key0");
+    EXPECT_EQ(all.table().get<2>(179)[0], 99);
+    remove(path);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,383 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// lock-free bounded queue and a batch pipeline from parse threads to consumer threads
+
+#ifndef GOODCODER_ROW_QUEUE_H
+#define GOODCODER_ROW_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parser.h"
+
+namespace baidu {
+
+/**
+ * BoundedQueue is a lock-free multi-producer multi-consumer ring
+ * every cell has a sequence number telling whether it is ready to push or pop
+ * (the algorithm of Dmitry Vyukov), so try_push and try_pop never take a lock
+ * push and pop spin SPIN_ROUNDS times, then sleep on a condition variable,
+ * so a waiting thread does not burn a core; a lock is taken only when a thread sleeps
+ * capacity is rounded up to a power of 2
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    //tries of push and pop before they sleep
+    static const int SPIN_ROUNDS = 64;
+
+    explicit BoundedQueue(size_t capacity) : _closed(false), _push_waiters(0), _pop_waiters(0) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        _mask = n - 1;
+        _cells = new Cell[n];
+        for (size_t i = 0; i < n; i++) {
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        _push_pos.store(0, std::memory_order_relaxed);
+        _pop_pos.store(0, std::memory_order_relaxed);
+    }
+
+    ~BoundedQueue() {
+        delete[] _cells;
+    }
+
+    /**
+     * @brief push without waiting
+     * @return bool
+     * @retval true:pushed, false:the queue is full
+    **/
+    bool try_push(const T& v) {
+        if (!push_cell(v)) {
+            return false;
+        }
+        wake(_pop_waiters, _not_empty);
+        return true;
+    }
+
+    /**
+     * @brief pop without waiting
+     * @return bool
+     * @retval true:popped to v, false:the queue is empty
+    **/
+    bool try_pop(T* v) {
+        if (!pop_cell(v)) {
+            return false;
+        }
+        wake(_push_waiters, _not_full);
+        return true;
+    }
+
+    //push, wait while the queue is full, this is the backpressure on producers
+    void push(const T& v) {
+        for (int i = 0; i < SPIN_ROUNDS; i++) {
+            if (try_push(v)) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _push_waiters.fetch_add(1, std::memory_order_relaxed);
+        //pairs with the fence of wake(): either this push sees the cell freed by a pop,
+        //or that pop sees this waiter and notifies it
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!push_cell(v)) {
+            _not_full.wait(lock);
+        }
+        _push_waiters.fetch_sub(1, std::memory_order_relaxed);
+        lock.unlock();
+        wake(_pop_waiters, _not_empty);
+    }
+
+    /**
+     * @brief pop, wait while the queue is empty and not closed
+     * @return bool
+     * @retval true:popped to v, false:the queue is closed and empty
+    **/
+    bool pop(T* v) {
+        for (int i = 0; i < SPIN_ROUNDS; i++) {
+            if (try_pop(v)) {
+                return true;
+            }
+            if (_closed.load(std::memory_order_acquire)) {
+                //pushes before close are visible now
+                return try_pop(v);
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _pop_waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool popped = true;
+        while (!pop_cell(v)) {
+            //close() sets _closed before it takes the lock to notify
+            if (_closed.load(std::memory_order_acquire)) {
+                popped = pop_cell(v);
+                break;
+            }
+            _not_empty.wait(lock);
+        }
+        _pop_waiters.fetch_sub(1, std::memory_order_relaxed);
+        lock.unlock();
+        if (popped) {
+            wake(_push_waiters, _not_full);
+        }
+        return popped;
+    }
+
+    //no more push after close, pop returns false when the queue is drained
+    void close() {
+        _closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _not_empty.notify_all();
+    }
+
+    size_t capacity() const {
+        return _mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    //wake a thread sleeping in push or pop, the lock is taken only when one sleeps
+    void wake(std::atomic<int>& waiters, std::condition_variable& cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            cv.notify_one();
+        }
+    }
+
+    bool push_cell(const T& v) {
+        size_t pos = _push_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = _cells[pos & _mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = v;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _push_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop_cell(T* v) {
+        size_t pos = _pop_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = _cells[pos & _mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (_pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    *v = cell.value;
+                    cell.seq.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _pop_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Cell* _cells;
+    size_t _mask;
+    //producers and consumers update different cache lines,
+    //padding instead of alignas, so the queue can be created by new before C++17
+    char _pad0[64];
+    std::atomic<size_t> _push_pos;
+    char _pad1[64];
+    std::atomic<size_t> _pop_pos;
+    char _pad2[64];
+    std::atomic<bool> _closed;
+    //threads sleeping in push and pop
+    std::atomic<int> _push_waiters;
+    std::atomic<int> _pop_waiters;
+    std::mutex _mutex;
+    std::condition_variable _not_full;
+    std::condition_variable _not_empty;
+    DISALLOW_COPY_AND_ASSIGN(BoundedQueue);
+};
+
+/**
+ * RowBatch holds up to capacity rows of a user row type R, capacity is 1 at least
+ * rows are reused by later batches, so their memory is allocated only once
+ */
+template <typename R>
+class RowBatch {
+public:
+    explicit RowBatch(size_t capacity) : _rows(std::max<size_t>(capacity, 1)), _size(0) {};
+
+    /**
+     * @brief the next row to fill, it keeps the content of an old row
+     * @return R*
+     * @retval NULL:the batch is full
+    **/
+    R* next_row() {
+        if (_size >= _rows.size()) {
+            return NULL;
+        }
+        return &_rows[_size++];
+    }
+
+    R& operator[](size_t i) {
+        return _rows[i];
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool full() const {
+        return _size == _rows.size();
+    }
+
+    size_t capacity() const {
+        return _rows.size();
+    }
+
+    void clear() {
+        _size = 0;
+    }
+
+private:
+    std::vector<R> _rows;
+    size_t _size;
+    DISALLOW_COPY_AND_ASSIGN(RowBatch);
+};
+
+/**
+ * BatchPipeline hands row batches from parse threads to consumer threads
+ * all batches are created at the beginning and recycled through a free queue,
+ * producers wait for a free batch when consumers fall behind
+ * usage:
+ *   producer: acquire(), fill rows, submit(); close() after all producers end
+ *   consumer: while (pop(&batch)) { read rows; recycle(batch); }
+ */
+template <typename R>
+class BatchPipeline {
+public:
+    /**
+     * @param [in] size_t batch_num, number of batches in flight, 0 is taken as 1
+     * @param [in] size_t batch_size, rows of a batch, 0 is taken as 1
+    **/
+    BatchPipeline(size_t batch_num, size_t batch_size) :
+            _free(std::max<size_t>(batch_num, 1)), _full(std::max<size_t>(batch_num, 1)) {
+        //no batch would make acquire() wait forever
+        batch_num = std::max<size_t>(batch_num, 1);
+        for (size_t i = 0; i < batch_num; i++) {
+            _batches.push_back(new RowBatch<R>(batch_size));
+            _free.push(_batches[i]);
+        }
+    }
+
+    ~BatchPipeline() {
+        for (size_t i = 0; i < _batches.size(); i++) {
+            delete _batches[i];
+        }
+    }
+
+    //get an empty batch, wait until consumers recycle one
+    RowBatch<R>* acquire() {
+        RowBatch<R>* batch = NULL;
+        _free.pop(&batch);
+        batch->clear();
+        return batch;
+    }
+
+    void submit(RowBatch<R>* batch) {
+        _full.push(batch);
+    }
+
+    /**
+     * @brief get a filled batch
+     * @return bool
+     * @retval true:got a batch, false:the pipeline is closed and drained
+    **/
+    bool pop(RowBatch<R>** batch) {
+        return _full.pop(batch);
+    }
+
+    void recycle(RowBatch<R>* batch) {
+        _free.push(batch);
+    }
+
+    //called after the last submit
+    void close() {
+        _full.close();
+    }
+
+    size_t batch_num() const {
+        return _batches.size();
+    }
+
+private:
+    std::vector<RowBatch<R>*> _batches;
+    BoundedQueue<RowBatch<R>*> _free;
+    BoundedQueue<RowBatch<R>*> _full;
+    DISALLOW_COPY_AND_ASSIGN(BatchPipeline);
+};
+
+/**
+ * BatchVisitor copies every parsed row into batches of a BatchPipeline
+ * implement fill() to copy the columns into a row, the row keeps the memory
+ * of an old row, so assigning or swapping into it does not allocate
+ * call flush() after the parse to submit the last batch
+ */
+template <typename R>
+class BatchVisitor : public RowVisitor {
+public:
+    explicit BatchVisitor(BatchPipeline<R>* pipeline) : _pipeline(pipeline), _batch(NULL) {};
+
+    virtual void fill(R& row) = 0;
+
+    virtual void visit() override {
+        if (_batch == NULL) {
+            _batch = _pipeline->acquire();
+        }
+        //a batch acquired is not full, it is submitted once full
+        fill(*_batch->next_row());
+        if (_batch->full()) {
+            _pipeline->submit(_batch);
+            _batch = NULL;
+        }
+    }
+
+    void flush() {
+        if (_batch != NULL && _batch->size() > 0) {
+            _pipeline->submit(_batch);
+        } else if (_batch != NULL) {
+            _pipeline->recycle(_batch);
+        }
+        _batch = NULL;
+    }
+
+private:
+    BatchPipeline<R>* _pipeline;
+    RowBatch<R>* _batch;
+    DISALLOW_COPY_AND_ASSIGN(BatchVisitor);
+};
+
+}
+#endif // GOODCODER_ROW_QUEUE_H
@@ -0,0 +1,260 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test BoundedQueue and BatchPipeline
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "parallel_parser.h"
+#include "row_queue.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::ParallelDictParser;
+using baidu::BoundedQueue;
+using baidu::RowBatch;
+using baidu::BatchPipeline;
+using baidu::BatchVisitor;
+
+//test queue in one thread
+TEST(BoundedQueue, single_thread) {
+    BoundedQueue<int> q(3);
+    EXPECT_EQ(q.capacity(), 4);
+    int v = 0;
+    EXPECT_FALSE(q.try_pop(&v));
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(q.try_push(i));
+    }
+    EXPECT_FALSE(q.try_push(4));
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(q.try_pop(&v));
+        EXPECT_EQ(v, i);
+    }
+    //wrap around
+    for (int round = 0; round < 10; round++) {
+        EXPECT_TRUE(q.try_push(round));
+        ASSERT_TRUE(q.try_pop(&v));
+        EXPECT_EQ(v, round);
+    }
+    q.push(7);
+    q.close();
+    ASSERT_TRUE(q.pop(&v));
+    EXPECT_EQ(v, 7);
+    EXPECT_FALSE(q.pop(&v));
+}
+
+//test queue with several producers and consumers
+TEST(BoundedQueue, multi_thread) {
+    BoundedQueue<int64_t> q(64);
+    const int producers = 4;
+    const int consumers = 4;
+    const int64_t per_producer = 100000;
+    std::atomic<int64_t> sum(0);
+    std::atomic<int64_t> count(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < consumers; i++) {
+        threads.push_back(std::thread([&]() {
+            int64_t v = 0;
+            int64_t local_sum = 0;
+            int64_t local_count = 0;
+            while (q.pop(&v)) {
+                local_sum += v;
+                local_count++;
+            }
+            sum += local_sum;
+            count += local_count;
+        }));
+    }
+    std::vector<std::thread> producer_threads;
+    for (int i = 0; i < producers; i++) {
+        producer_threads.push_back(std::thread([&q, i, per_producer]() {
+            for (int64_t v = 1; v <= per_producer; v++) {
+                q.push(v + i * per_producer);
+            }
+        }));
+    }
+    for (size_t i = 0; i < producer_threads.size(); i++) {
+        producer_threads[i].join();
+    }
+    q.close();
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    int64_t n = producers * per_producer;
+    EXPECT_EQ(count.load(), n);
+    EXPECT_EQ(sum.load(), n * (n + 1) / 2);
+}
+
+//test sizes of 0 are taken as 1
+TEST(BatchPipeline, zero_sizes) {
+    BatchPipeline<int> pipeline(0, 0);
+    EXPECT_EQ(pipeline.batch_num(), 1);
+    RowBatch<int>* batch = pipeline.acquire();
+    ASSERT_TRUE(batch != NULL);
+    EXPECT_EQ(batch->capacity(), 1);
+    int* row = batch->next_row();
+    ASSERT_TRUE(row != NULL);
+    *row = 5;
+    EXPECT_TRUE(batch->full());
+    EXPECT_TRUE(batch->next_row() == NULL);
+    EXPECT_EQ(batch->size(), 1);
+    pipeline.submit(batch);
+    pipeline.close();
+    ASSERT_TRUE(pipeline.pop(&batch));
+    EXPECT_EQ((*batch)[0], 5);
+    pipeline.recycle(batch);
+    EXPECT_FALSE(pipeline.pop(&batch));
+}
+
+static double thread_cpu_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+//test a waiting consumer and a waiting producer sleep instead of spinning
+TEST(BoundedQueue, sleep) {
+    BoundedQueue<int> q(2);
+    double consumer_ms = 0;
+    int v = 0;
+    std::thread consumer([&]() {
+        double start = thread_cpu_ms();
+        EXPECT_TRUE(q.pop(&v));
+        consumer_ms = thread_cpu_ms() - start;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    q.push(42);
+    consumer.join();
+    EXPECT_EQ(v, 42);
+    EXPECT_LT(consumer_ms, 100);
+
+    //full queue, the producer waits for a pop
+    q.push(1);
+    q.push(2);
+    double producer_ms = 0;
+    std::thread producer([&]() {
+        double start = thread_cpu_ms();
+        q.push(3);
+        producer_ms = thread_cpu_ms() - start;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_TRUE(q.try_pop(&v));
+    producer.join();
+    EXPECT_LT(producer_ms, 100);
+
+    //close wakes a sleeping consumer
+    ASSERT_TRUE(q.pop(&v));
+    ASSERT_TRUE(q.pop(&v));
+    EXPECT_EQ(v, 3);
+    std::thread closed([&]() {
+        int u = 0;
+        EXPECT_FALSE(q.pop(&u));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    q.close();
+    closed.join();
+}
+
+//the row type handed to consumers
+struct Row {
+    int id;
+    std::string name;
+};
+
+//a parse worker, copies its columns into batches
+class Worker : public BatchVisitor<Row> {
+public:
+    explicit Worker(BatchPipeline<Row>* pipeline) : BatchVisitor<Row>(pipeline) {
+        lp.add_parser(&id);
+        lp.add_parser(&name);
+    }
+
+    virtual void fill(Row& row) override {
+        row.id = id.data();
+        row.name.swap(name.data());
+    }
+
+    Parser<int> id;
+    Parser<std::string> name;
+    LineParser lp;
+};
+
+//test parse threads feed consumer threads through the pipeline
+TEST(BatchPipeline, parse) {
+    const char* path = "row_queue.txt";
+    const int lines = 50000;
+    std::ofstream out(path);
+    for (int i = 0; i < lines; i++) {
+        out << i << "\tname" << i % 100 << "\n";
+    }
+    out.close();
+
+    //few batches, producers have to wait for consumers
+    BatchPipeline<Row> pipeline(4, 64);
+    std::vector<Worker*> workers;
+    ParallelDictParser pdp(path);
+    for (int i = 0; i < 4; i++) {
+        workers.push_back(new Worker(&pipeline));
+        pdp.add_worker(&workers[i]->lp, workers[i]);
+    }
+
+    std::atomic<int64_t> sum(0);
+    std::atomic<int64_t> count(0);
+    std::atomic<int64_t> bad_names(0);
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 2; i++) {
+        consumers.push_back(std::thread([&]() {
+            RowBatch<Row>* batch = NULL;
+            while (pipeline.pop(&batch)) {
+                for (size_t j = 0; j < batch->size(); j++) {
+                    Row& row = (*batch)[j];
+                    sum += row.id;
+                    count++;
+                    if (row.name != "name" + std::to_string(row.id % 100)) {
+                        bad_names++;
+                    }
+                }
+                pipeline.recycle(batch);
+            }
+        }));
+    }
+
+    ASSERT_EQ(pdp.parse(), 0);
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->flush();
+    }
+    pipeline.close();
+    for (size_t i = 0; i < consumers.size(); i++) {
+        consumers[i].join();
+    }
+    EXPECT_EQ(count.load(), lines);
+    EXPECT_EQ(sum.load(), static_cast<int64_t>(lines) * (lines - 1) / 2);
+    EXPECT_EQ(bad_names.load(), 0);
+    EXPECT_EQ(pipeline.batch_num(), 4);
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        delete workers[i];
+    }
+    remove(path);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
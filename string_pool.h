@@ -0,0 +1,143 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// dictionary encoding for low-cardinality string columns:
+// StringPool interns strings, DictStringParser stores a 32-bit code per row
+
+#ifndef GOODCODER_STRING_POOL_H
+#define GOODCODER_STRING_POOL_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+#include <com_log.h>
+
+#include "parser.h"
+
+namespace baidu {
+
+//code of a string which is not in a StringPool
+const uint32_t INVALID_CODE = 0xFFFFFFFF;
+
+/**
+ * StringPool keeps one copy of every distinct string and gives it a dense code
+ * code -> string is a vector index, string -> code is a hash lookup
+ * it is not thread-safe, share it between threads only for reading
+ */
+class StringPool {
+public:
+    StringPool() {};
+
+    /**
+     * @brief get the code of a string, add it to the pool when absent
+     * @param [in] std::string s
+     * @return uint32_t
+     * @retval code of s, codes are dense and start from 0
+     * @exception throw std::length_error when the pool is full
+    **/
+    uint32_t intern(const std::string& s) {
+        std::unordered_map<std::string, uint32_t>::const_iterator it = _codes.find(s);
+        if (it != _codes.end()) {
+            return it->second;
+        }
+        if (_strs.size() >= INVALID_CODE) {
+            throw std::length_error("string pool is full");
+        }
+        uint32_t code = static_cast<uint32_t>(_strs.size());
+        it = _codes.insert(std::make_pair(s, code)).first;
+        //keys of unordered_map never move, so the pointer stays valid after rehash
+        _strs.push_back(&it->first);
+        return code;
+    }
+
+    /**
+     * @brief get the code of a string without adding it
+     * @param [in] std::string s
+     * @return uint32_t
+     * @retval code of s, INVALID_CODE when s is not in the pool
+    **/
+    uint32_t find(const std::string& s) const {
+        std::unordered_map<std::string, uint32_t>::const_iterator it = _codes.find(s);
+        if (it == _codes.end()) {
+            return INVALID_CODE;
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief get the string of a code
+     * @param [in] uint32_t code, should be returned by intern
+     * @return const std::string&
+     * @exception throw std::out_of_range when code is unknown
+    **/
+    const std::string& str(uint32_t code) const {
+        if (code >= _strs.size()) {
+            throw std::out_of_range("unknown string pool code");
+        }
+        return *_strs[code];
+    }
+
+    size_t size() const {
+        return _strs.size();
+    }
+
+    void reserve(size_t n) {
+        _codes.reserve(n);
+        _strs.reserve(n);
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> _codes;
+    std::vector<const std::string*> _strs;
+    DISALLOW_COPY_AND_ASSIGN(StringPool);
+};
+
+/**
+ * DictStringParser is used instead of Parser<std::string> for low-cardinality columns
+ * every value is interned into a StringPool which may be shared by several columns
+ * data() is the code of this row, compare codes instead of strings
+ */
+class DictStringParser : public ParserBase {
+public:
+    explicit DictStringParser(StringPool* pool) : _pool(pool), _data(INVALID_CODE) {};
+
+    /**
+     * @brief intern str and set its code to data
+     *        will be called by LineParser::parse
+     * @param [in] std::string str
+     * @return int
+     * @retval 0:succeed, -1:the pool is full
+    **/
+    virtual int parse(const std::string& str) override {
+        try {
+            _data = _pool->intern(str);
+        } catch (std::exception& e) {
+            report_error(PARSE_ERROR_COLUMN, e.what());
+            return -1;
+        }
+        return 0;
+    }
+
+    uint32_t& data() {
+        return _data;
+    }
+
+    const std::string& str() const {
+        return _pool->str(_data);
+    }
+
+    StringPool* pool() const {
+        return _pool;
+    }
+private:
+    StringPool* _pool;
+    uint32_t _data;
+    DISALLOW_COPY_AND_ASSIGN(DictStringParser);
+};
+
+}
+#endif // GOODCODER_STRING_POOL_H
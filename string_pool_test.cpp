@@ -0,0 +1,82 @@
+// Copyright 2017 Baidu Inc. All Rights Reserved.
+// Author: Fucheng zhang (zhangfucheng@baidu.com)
+//
+// call gtest to test string pool
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "string_pool.h"
+
+namespace test {
+
+using baidu::Parser;
+using baidu::LineParser;
+using baidu::StringPool;
+using baidu::DictStringParser;
+
+//test StringPool intern and lookup
+TEST(StringPool, intern) {
+    StringPool pool;
+    EXPECT_EQ(pool.size(), 0);
+    EXPECT_EQ(pool.find("beijing"), baidu::INVALID_CODE);
+
+    EXPECT_EQ(pool.intern("beijing"), 0);
+    EXPECT_EQ(pool.intern("shanghai"), 1);
+    EXPECT_EQ(pool.intern("beijing"), 0);
+    EXPECT_EQ(pool.intern(""), 2);
+    EXPECT_EQ(pool.size(), 3);
+
+    EXPECT_EQ(pool.find("shanghai"), 1);
+    EXPECT_STREQ(pool.str(0).c_str(), "beijing");
+    EXPECT_STREQ(pool.str(1).c_str(), "shanghai");
+    EXPECT_STREQ(pool.str(2).c_str(), "");
+    EXPECT_THROW(pool.str(3), std::out_of_range);
+}
+
+//strings must stay valid when the pool grows
+TEST(StringPool, grow) {
+    StringPool pool;
+    const std::string& first = pool.str(pool.intern("first"));
+    for (int i = 0; i < 10000; i++) {
+        EXPECT_EQ(pool.intern(std::to_string(i)), static_cast<uint32_t>(i + 1));
+    }
+    EXPECT_STREQ(first.c_str(), "first");
+    EXPECT_STREQ(pool.str(5001).c_str(), "5000");
+}
+
+//test LineParser with dictionary encoded columns sharing one pool
+TEST(DictStringParser, line) {
+    StringPool pool;
+    Parser<int> p0;
+    DictStringParser p1(&pool);
+    DictStringParser p2(&pool);
+    LineParser lp;
+    lp.add_parser(&p0);
+    lp.add_parser(&p1);
+    lp.add_parser(&p2);
+
+    EXPECT_EQ(lp.parse("1\tbeijing\tnorth"), 0);
+    uint32_t beijing = p1.data();
+    EXPECT_STREQ(p1.str().c_str(), "beijing");
+    EXPECT_STREQ(p2.str().c_str(), "north");
+
+    EXPECT_EQ(lp.parse("2\tguangzhou\tsouth"), 0);
+    EXPECT_NE(p1.data(), beijing);
+
+    EXPECT_EQ(lp.parse("3\tbeijing\tbeijing"), 0);
+    EXPECT_EQ(p1.data(), beijing);
+    EXPECT_EQ(p2.data(), beijing);
+    EXPECT_EQ(pool.size(), 4);
+
+    EXPECT_EQ(lp.parse("abc\tbeijing\tnorth"), -1);
+}
+
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}